@@ -0,0 +1,292 @@
+#ifndef BINARYIO_HPP
+#define BINARYIO_HPP
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <span>
+#include <bit>
+#include <cstdint>
+#include <algorithm>
+#include <filesystem>
+
+#include "filehandler.hpp"
+
+namespace fs = std::filesystem;
+
+// Format of the result files: tab-separated text, raw binary records behind a text header, or NumPy .npy arrays
+enum class OutputFormat
+{
+	Text,
+	Binary,
+	Npy
+};
+
+// File extension used for each output format
+inline std::string output_extension(OutputFormat format)
+{
+	switch (format)
+	{
+	case OutputFormat::Binary:
+		return ".bin";
+	case OutputFormat::Npy:
+		return ".npy";
+	default:
+		return ".dat";
+	}
+}
+
+// Byte order of the written doubles, as named by gnuplot's endian= option
+inline std::string native_endian_name()
+{
+	return std::endian::native == std::endian::little ? "little" : "big";
+}
+
+// BinaryLayout struct describing a written binary file, enough for a reader to skip the header and decode the records
+struct BinaryLayout
+{
+	std::string filename;
+	std::size_t headerBytes = 0; // Bytes before the first record
+	std::size_t numColumns = 0;	 // Doubles per record
+	std::size_t numRecords = 0;
+};
+
+/**
+ * @brief Writes equally long columns as binary float64 records (one record per row) behind a small header.
+ *
+ * @param[in] columns Columns to be written; record i holds columns[0][i], columns[1][i], ...
+ * @param[in] names Name of each column, stored in the header.
+ * @param[in] filename Name of the file to write the data to.
+ * @param[in] format OutputFormat::Binary or OutputFormat::Npy.
+ * @param[in] extraInfo Optional vector of strings representing extra information stored in the header.
+ * @param[out] layout Optional description of the written file (header size, record shape).
+ *
+ * @return True if the whole file was written, false otherwise.
+ *
+ * @details Binary: the header is the usual "# ..." text lines (extraInfo, column names,
+ * record count and format) padded to a multiple of 8 bytes, so "head" still shows
+ * them and gnuplot skips them with binary skip=. Npy: a version 1.0 .npy file holding
+ * a (records x columns) float64 array, loadable with numpy.load; since the .npy header
+ * has no room for free text, the extraInfo lines go to filename + ".info".
+ */
+bool write_binary_records(const std::vector<std::span<const double>> &columns,
+													const std::vector<std::string> &names,
+													const std::string &filename,
+													OutputFormat format,
+													const std::vector<std::string> &extraInfo = {},
+													BinaryLayout *layout = nullptr)
+{
+	const std::size_t numColumns = columns.size();
+	const std::size_t numRecords = columns.empty() ? 0 : columns[0].size();
+	for (const auto &column : columns)
+	{
+		if (column.size() != numRecords)
+		{
+			std::cerr << "Error: columns of different lengths cannot be written to " << filename << std::endl;
+			return false;
+		}
+	}
+
+	std::string header;
+	if (format == OutputFormat::Npy)
+	{
+		header = "{'descr': '" + std::string(std::endian::native == std::endian::little ? "<" : ">") +
+						 "f8', 'fortran_order': False, 'shape': (" + std::to_string(numRecords) + ", " +
+						 std::to_string(numColumns) + "), }";
+		// Magic (6) + version (2) + header length (2) + dict + padding + '\n' is a multiple of 64
+		std::size_t total = 10 + header.size() + 1;
+		header.append((64 - total % 64) % 64, ' ');
+		header += '\n';
+		std::uint16_t length = static_cast<std::uint16_t>(header.size());
+		std::string preamble("\x93NUMPY\x01\x00", 8);
+		preamble += static_cast<char>(length & 0xFF);
+		preamble += static_cast<char>(length >> 8);
+		header = preamble + header;
+
+		if (!extraInfo.empty())
+		{
+			std::ofstream info(filename + ".info");
+			for (const auto &line : extraInfo)
+			{
+				info << line << "\n";
+			}
+		}
+	}
+	else
+	{
+		for (const auto &line : extraInfo)
+		{
+			header += line + "\n";
+		}
+		header += "# columns:";
+		for (const auto &name : names)
+		{
+			header += " " + name;
+		}
+		header += "\n# records: " + std::to_string(numRecords) + "\n# format: " + std::to_string(numColumns) +
+							" x float64 per record, " + native_endian_name() + " endian\n";
+		// Pad the last line so that the records start 8-byte aligned
+		header.insert(header.size() - 1, (8 - header.size() % 8) % 8, ' ');
+	}
+
+	std::ofstream outFile(filename, std::ios::binary);
+	if (!outFile)
+	{
+		std::cerr << "Error opening file for writing: " << filename << std::endl;
+		return false;
+	}
+	outFile.write(header.data(), header.size());
+
+	// Interleave the columns into records one chunk at a time
+	const std::size_t chunkRecords = std::max<std::size_t>(1, (1 << 16) / std::max<std::size_t>(numColumns, 1));
+	std::vector<double> buffer(chunkRecords * numColumns);
+	for (std::size_t first = 0; first < numRecords; first += chunkRecords)
+	{
+		std::size_t count = std::min(chunkRecords, numRecords - first);
+		for (std::size_t r = 0; r < count; ++r)
+		{
+			for (std::size_t c = 0; c < numColumns; ++c)
+			{
+				buffer[r * numColumns + c] = columns[c][first + r];
+			}
+		}
+		outFile.write(reinterpret_cast<const char *>(buffer.data()), count * numColumns * sizeof(double));
+	}
+	outFile.close();
+	if (!outFile)
+	{
+		std::cerr << "Error writing to output file: " << filename << std::endl;
+		return false;
+	}
+
+	if (layout)
+	{
+		*layout = {filename, header.size(), numColumns, numRecords};
+	}
+	return true;
+}
+
+/**
+ * @brief Same as write_pair_data_to_file in the requested output format.
+ *
+ * @param[in] data Vector of pairs of integers and doubles to be written to the file.
+ * @param[in] basename Name of the file without extension; output_extension(format) is appended.
+ * @param[in] headers Column names (a leading '#' is dropped in binary headers).
+ * @param[in] extraInfo Optional vector of strings representing extra information to be written before headers.
+ * @param[in] format Output format.
+ * @param[out] layout Optional description of the written binary file.
+ * @param[in] errors Optional error of every second value, written as a third column.
+ *
+ * @return True if the whole file was written, false otherwise.
+ */
+bool write_pair_data(const std::vector<std::pair<int, double>> &data,
+										 const std::string &basename,
+										 const std::vector<std::string> &headers,
+										 const std::vector<std::string> &extraInfo,
+										 OutputFormat format,
+										 BinaryLayout *layout = nullptr,
+										 const std::vector<double> &errors = {})
+{
+	const std::string filename = basename + output_extension(format);
+	if (format == OutputFormat::Text)
+	{
+		return write_pair_data_to_file(data, filename, headers, extraInfo, errors);
+	}
+
+	std::vector<double> first, second;
+	first.reserve(data.size());
+	second.reserve(data.size());
+	for (const auto &pair : data)
+	{
+		first.push_back(pair.first);
+		second.push_back(pair.second);
+	}
+
+	std::vector<std::string> names;
+	for (const auto &header : headers)
+	{
+		names.push_back(header.empty() || header[0] != '#' ? header : header.substr(1));
+	}
+	std::vector<std::span<const double>> columns = {first, second};
+	if (!errors.empty())
+		columns.push_back(errors);
+	return write_binary_records(columns, names, filename, format, extraInfo, layout);
+}
+
+// GnuplotSeries struct describing one curve of a generated gnuplot script
+struct GnuplotSeries
+{
+	BinaryLayout layout;
+	std::string title;
+	std::string columns = "1:2"; // gnuplot "using" specification
+};
+
+/**
+ * @brief Generates a gnuplot script plotting binary result files with binary format= loading.
+ *
+ * @param[in] scriptFile Name of the script to be written; data files are referenced relative to its directory.
+ * @param[in] series Curves to be plotted, with the layout returned by the binary writers.
+ * @param[in] xlabel Label of the x axis.
+ * @param[in] ylabel Label of the y axis.
+ * @param[in] title Title of the plot.
+ *
+ * @details Mirrors the style of output/plot_autocorr_GP.gnu; run it from the output
+ * directory with "gnuplot <script>".
+ */
+void write_gnuplot_binary_script(const std::string &scriptFile,
+																 const std::vector<GnuplotSeries> &series,
+																 const std::string &xlabel,
+																 const std::string &ylabel,
+																 const std::string &title)
+{
+	std::ofstream out(scriptFile);
+	if (!out)
+	{
+		std::cerr << "Error opening file for writing: " << scriptFile << std::endl;
+		return;
+	}
+
+	const std::vector<std::string> colors = {"blue", "red", "dark-green", "orange", "purple", "black"};
+
+	out << "\n# Set the data file names\n";
+	for (size_t i = 0; i < series.size(); ++i)
+	{
+		out << "datafile" << i + 1 << " = \"" << fs::path(series[i].layout.filename).filename().string() << "\"\n";
+	}
+
+	out << "\n# Set plot style\n"
+			<< "set style data linespoints\n"
+			<< "set pointsize 1.5 # Adjust point size if necessary\n";
+	for (size_t i = 0; i < series.size(); ++i)
+	{
+		out << "set style line " << i + 1 << " lc rgb '" << colors[i % colors.size()] << "' pt 1 lt 1\n";
+	}
+
+	out << "\n# Labels\n"
+			<< "set xlabel \"" << xlabel << "\"\n"
+			<< "set ylabel \"" << ylabel << "\"\n"
+			<< "set title '" << title << "'\n"
+			<< "set grid\n"
+			<< "\nf(x) = 0;\n"
+			<< "# Plot command (binary records: skip the header, then float64 columns)\n"
+			<< "plot ";
+	for (size_t i = 0; i < series.size(); ++i)
+	{
+		std::string format;
+		for (size_t c = 0; c < series[i].layout.numColumns; ++c)
+		{
+			format += "%float64";
+		}
+		out << "datafile" << i + 1 << " binary skip=" << series[i].layout.headerBytes
+				<< " record=" << series[i].layout.numRecords << " format=\"" << format << "\""
+				<< " endian=" << native_endian_name()
+				<< " using " << series[i].columns << " with linespoints linestyle " << i + 1
+				<< " title '" << series[i].title << "',\\\n     ";
+	}
+	out << "f(x) with lines lt -1\n"
+			<< "# Pause and wait for the user to close the window\n"
+			<< "pause -1 \"Press Enter to close the plot...\"\n";
+}
+
+#endif // binaryio.hpp
@@ -0,0 +1,229 @@
+#ifndef DEDUP_HPP
+#define DEDUP_HPP
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+// Word-at-a-time 64-bit hash of a buffer (not cryptographic, only used to find identical files)
+inline std::uint64_t hash_block(const char *data, std::size_t size, std::uint64_t h = 0x9E3779B97F4A7C15ULL)
+{
+	auto mix = [](std::uint64_t x)
+	{
+		x ^= x >> 33;
+		x *= 0xFF51AFD7ED558CCDULL;
+		x ^= x >> 33;
+		return x;
+	};
+
+	std::size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		std::uint64_t w;
+		std::memcpy(&w, data + i, 8);
+		h = mix(h ^ w) * 0xC4CEB9FE1A85EC53ULL;
+	}
+	std::uint64_t tail = 0;
+	std::memcpy(&tail, data + i, size - i);
+	return mix(h ^ tail ^ size);
+}
+
+/**
+ * @brief Hashes a file, either fully or only from a few sampled blocks.
+ *
+ * @param[in] path Path to the file to be hashed.
+ * @param[in] fileSize Size of the file in bytes.
+ * @param[in] full If true the whole file is hashed, otherwise only the first, middle and last blocks.
+ * @param[out] hash The hash of the file, only valid if the function returns true.
+ * @param[in] blockSize Size of the sampled blocks (and of the reads for the full hash).
+ *
+ * @return True if every hashed block could be read, false (with an error message) otherwise.
+ */
+bool hash_file(const fs::path &path, std::uintmax_t fileSize, bool full, std::uint64_t &hash, std::size_t blockSize = 4096)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		std::cerr << "Error opening file: " << path << std::endl;
+		return false;
+	}
+
+	std::vector<char> block(blockSize);
+	std::uint64_t h = fileSize;
+	bool ok = true;
+	auto hash_at = [&](std::uintmax_t offset)
+	{
+		file.seekg(static_cast<std::streamoff>(offset));
+		file.read(block.data(), block.size());
+		const auto count = static_cast<std::size_t>(file.gcount());
+		// Every block lies inside the file, so a short read means the file changed or could not be read
+		if (file.bad() || count != std::min<std::uintmax_t>(block.size(), fileSize - offset))
+			ok = false;
+		h = hash_block(block.data(), count, h);
+		file.clear();
+	};
+
+	if (full || fileSize <= 3 * blockSize)
+	{
+		for (std::uintmax_t offset = 0; offset < fileSize; offset += blockSize)
+		{
+			hash_at(offset);
+		}
+	}
+	else
+	{
+		hash_at(0);
+		hash_at((fileSize - blockSize) / 2);
+		hash_at(fileSize - blockSize);
+	}
+	if (!ok)
+	{
+		std::cerr << "Error reading file: " << path << std::endl;
+		return false;
+	}
+	hash = h;
+	return true;
+}
+
+/**
+ * @brief Removes files with identical contents from a list, keeping the first occurrence.
+ *
+ * @param[in] files Paths of the data files, possibly from several directories.
+ * @param[out] duplicates Optional list of (skipped file, kept file) pairs.
+ *
+ * @return The files with unique contents, in their original order.
+ *
+ * @details Files are first grouped by size; only files sharing a size are hashed
+ * from three sampled blocks, and only files sharing the sampled hash are hashed in
+ * full. Most files are therefore only stat'ed. Files that cannot be stat'ed or hashed
+ * are always kept, never reported as duplicates.
+ */
+std::vector<fs::path> deduplicate_files(const std::vector<fs::path> &files,
+																				std::vector<std::pair<fs::path, fs::path>> *duplicates = nullptr)
+{
+	std::map<std::uintmax_t, std::vector<size_t>> bySize;
+	std::vector<std::uintmax_t> sizes(files.size(), 0);
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		std::error_code ec;
+		sizes[i] = fs::file_size(files[i], ec);
+		if (ec)
+		{
+			std::cerr << "Error reading size of file: " << files[i] << " (" << ec.message() << ")" << std::endl;
+			continue;
+		}
+		bySize[sizes[i]].push_back(i);
+	}
+
+	std::vector<bool> skip(files.size(), false);
+	for (const auto &[size, group] : bySize)
+	{
+		if (group.size() < 2)
+			continue;
+
+		// Sampled hash, then full hash on collision
+		std::map<std::uint64_t, std::vector<size_t>> bySample;
+		std::uint64_t hash;
+		for (size_t i : group)
+		{
+			if (hash_file(files[i], size, false, hash))
+				bySample[hash].push_back(i);
+		}
+
+		for (const auto &[_, candidates] : bySample)
+		{
+			if (candidates.size() < 2)
+				continue;
+
+			std::map<std::uint64_t, size_t> firstByHash;
+			for (size_t i : candidates)
+			{
+				if (!hash_file(files[i], size, true, hash))
+					continue;
+				auto [it, inserted] = firstByHash.emplace(hash, i);
+				if (!inserted)
+				{
+					skip[i] = true;
+					if (duplicates)
+						duplicates->emplace_back(files[i], files[it->second]);
+				}
+			}
+		}
+	}
+
+	std::vector<fs::path> unique;
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		if (!skip[i])
+			unique.push_back(files[i]);
+	}
+	return unique;
+}
+
+// Returns the trailing integer of a file stem, e.g. 123 for "landau-123.out", or -1 if there is none
+inline int config_number_from_filename(const fs::path &path)
+{
+	std::string stem = path.stem().string();
+	size_t pos = stem.size();
+	while (pos > 0 && std::isdigit(static_cast<unsigned char>(stem[pos - 1])))
+		--pos;
+	return pos == stem.size() ? -1 : std::atoi(stem.c_str() + pos);
+}
+
+/**
+ * @brief Lists the data files of one or more directories, optionally skipping duplicated contents.
+ *
+ * @param[in] directoryPaths Directories containing the data files.
+ * @param[in] fileType The extension of the files to be listed.
+ * @param[in] deduplicate If true, files whose contents duplicate an earlier file are skipped and reported.
+ *
+ * @return The paths of the files, sorted by directory and then by configuration number,
+ * so that the earliest configuration of a set of duplicates is the one kept.
+ */
+std::vector<fs::path> list_data_files(const std::vector<std::string> &directoryPaths, const std::string &fileType, bool deduplicate = true)
+{
+	std::vector<fs::path> files;
+	for (const auto &directoryPath : directoryPaths)
+	{
+		std::vector<fs::path> dirFiles;
+		for (const auto &entry : fs::directory_iterator(directoryPath))
+		{
+			if (entry.path().extension() == fileType)
+			{
+				dirFiles.push_back(entry.path());
+			}
+		}
+		std::sort(dirFiles.begin(), dirFiles.end(), [](const fs::path &a, const fs::path &b)
+							{
+								int na = config_number_from_filename(a), nb = config_number_from_filename(b);
+								return na != nb ? na < nb : a < b; });
+		files.insert(files.end(), dirFiles.begin(), dirFiles.end());
+	}
+
+	if (!deduplicate)
+		return files;
+
+	std::vector<std::pair<fs::path, fs::path>> duplicates;
+	std::vector<fs::path> unique = deduplicate_files(files, &duplicates);
+	for (const auto &[skipped, kept] : duplicates)
+	{
+		std::cerr << "Skipping duplicate file: " << skipped << " (same contents as " << kept << ")" << std::endl;
+	}
+	if (!duplicates.empty())
+	{
+		std::cout << "Skipped " << duplicates.size() << " duplicate file(s) out of " << files.size() << std::endl;
+	}
+	return unique;
+}
+
+#endif // dedup.hpp
@@ -4,12 +4,14 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <filesystem>
 #include <regex>
 #include <unordered_map>
 #include <sstream>
 #include <algorithm>
+#include <functional>
 
 namespace fs = std::filesystem;
 
@@ -21,6 +23,123 @@ struct MatchData
 	std::unordered_map<std::string, std::vector<double>> values; // Maps patterns to their corresponding values
 };
 
+/**
+ * @brief Appends the value of every pattern found in a single line to fileData.
+ *
+ * @param[in] line The line of text to be matched against the patterns.
+ * @param[in] patterns The set of patterns to search for in the line.
+ * @param[in,out] fileData The MatchData struct where the extracted values are stored.
+ */
+void extract_pattern_values_from_line(const std::string &line, const std::vector<std::string> &patterns, MatchData &fileData)
+{
+	for (const auto &pattern : patterns)
+	{
+		if (line.find(pattern) != std::string::npos)
+		{
+			std::istringstream iss(line);
+			std::string label;
+			double value;
+
+			// Read the pattern and skip the corresponding parts
+			iss >> label; // Read the first part (the pattern)
+			std::vector<std::string> patternParts;
+			std::istringstream patternStream(pattern);
+			std::string part;
+
+			// Split the pattern into parts
+			while (patternStream >> part)
+			{
+				patternParts.push_back(part);
+			}
+
+			// Skip the number of parts in the pattern minus one (for the label)
+			for (size_t i = 1; i < patternParts.size(); ++i)
+			{
+				iss >> label; // Skip the next parts
+			}
+
+			// Read the value
+			iss >> value;
+			fileData.values[pattern].push_back(value);
+		}
+	}
+}
+
+/**
+ * @brief Extracts values from an input stream based on a set of patterns.
+ *
+ * @param[in] input The stream holding the contents of one data file.
+ * @param[in] fileName The name stored in the returned MatchData struct.
+ * @param[in] patterns The set of patterns to search for in the stream.
+ *
+ * @return A MatchData struct with one (possibly empty) vector of values per pattern.
+ */
+MatchData extract_pattern_values_from_stream(std::istream &input, const std::string &fileName, const std::vector<std::string> &patterns)
+{
+	MatchData fileData;
+	fileData.fileName = fileName;
+	std::string line;
+
+	// Initialize values map for each pattern
+	for (const auto &pattern : patterns)
+	{
+		fileData.values[pattern] = {};
+	}
+
+	while (std::getline(input, line))
+	{
+		extract_pattern_values_from_line(line, patterns, fileData);
+	}
+	return fileData;
+}
+
+/**
+ * @brief Same as extract_pattern_values_from_stream for a file already held in memory.
+ *
+ * @param[in] data The contents of one data file; it is parsed in place, only one line at a time is copied.
+ * @param[in] fileName The name stored in the returned MatchData struct.
+ * @param[in] patterns The set of patterns to search for in the buffer.
+ *
+ * @return A MatchData struct with one (possibly empty) vector of values per pattern.
+ */
+MatchData extract_pattern_values_from_buffer(std::string_view data, const std::string &fileName, const std::vector<std::string> &patterns)
+{
+	MatchData fileData;
+	fileData.fileName = fileName;
+
+	// Initialize values map for each pattern
+	for (const auto &pattern : patterns)
+	{
+		fileData.values[pattern] = {};
+	}
+
+	std::string line;
+	std::size_t pos = 0;
+	while (pos < data.size())
+	{
+		std::size_t eol = data.find('\n', pos);
+		if (eol == std::string_view::npos)
+			eol = data.size();
+		line.assign(data.data() + pos, eol - pos);
+		extract_pattern_values_from_line(line, patterns, fileData);
+		pos = eol + 1;
+	}
+	return fileData;
+}
+
+// Returns true if at least one of the patterns has been matched in fileData
+inline bool match_data_has_values(const MatchData &fileData)
+{
+	for (const auto &[_, values] : fileData.values)
+	{
+		if (!values.empty())
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
 /**
  * @brief Extracts values from a set of files in a given directory based on a set of patterns.
  *
@@ -45,63 +164,11 @@ std::vector<MatchData> extract_pattern_values_from_file(const std::string &direc
 				continue;
 			}
 
-			MatchData fileData;
-			fileData.fileName = entry.path().filename().string();
-			std::string line;
-
-			// Initialize values map for each pattern
-			for (const auto &pattern : patterns)
-			{
-				fileData.values[pattern] = {};
-			}
-
-			while (std::getline(file, line))
-			{
-				for (const auto &pattern : patterns)
-				{
-					if (line.find(pattern) != std::string::npos)
-					{
-						std::istringstream iss(line);
-						std::string label;
-						double value;
-
-						// Read the pattern and skip the corresponding parts
-						iss >> label; // Read the first part (the pattern)
-						std::vector<std::string> patternParts;
-						std::istringstream patternStream(pattern);
-						std::string part;
-
-						// Split the pattern into parts
-						while (patternStream >> part)
-						{
-							patternParts.push_back(part);
-						}
-
-						// Skip the number of parts in the pattern minus one (for the label)
-						for (size_t i = 1; i < patternParts.size(); ++i)
-						{
-							iss >> label; // Skip the next parts
-						}
-
-						// Read the value
-						iss >> value;
-						fileData.values[pattern].push_back(value);
-					}
-				}
-			}
+			MatchData fileData = extract_pattern_values_from_stream(file, entry.path().filename().string(), patterns);
 			file.close();
 
 			// Store the file data if any values were found
-			bool hasValues = false;
-			for (const auto &pattern : patterns)
-			{
-				if (!fileData.values[pattern].empty())
-				{
-					hasValues = true;
-					break;
-				}
-			}
-			if (hasValues)
+			if (match_data_has_values(fileData))
 			{
 				gpDataList.push_back(fileData);
 			}
@@ -122,10 +189,13 @@ std::vector<MatchData> extract_pattern_values_from_file(const std::string &direc
  * @param[in] data --- Vector of MatchData objects containing data to be written.
  * @param[in] outputFileName --- Path to the output file.
  * @param[in] headers --- Optional custom headers to use for the columns. If empty, headers are inferred from data.
+ * @param[in] columnOrder --- Optional patterns in the order of their columns (a pattern missing from a file gives NaN).
+ * If empty, the columns follow the iteration order of MatchData::values, which is unspecified.
  */
 void write_match_data_to_file(const std::vector<MatchData> &data,
 															const std::string &outputFileName,
-															const std::vector<std::string> &headers = {})
+															const std::vector<std::string> &headers = {},
+															const std::vector<std::string> &columnOrder = {})
 {
 	std::ofstream outFile(outputFileName);
 
@@ -135,6 +205,24 @@ void write_match_data_to_file(const std::vector<MatchData> &data,
 		return;
 	}
 
+	// Values of each column of one file
+	const std::vector<double> missing;
+	auto columns_of = [&](const MatchData &gpData)
+	{
+		std::vector<std::pair<const std::string *, const std::vector<double> *>> columns;
+		if (columnOrder.empty())
+		{
+			for (const auto &[pattern, values] : gpData.values)
+				columns.emplace_back(&pattern, &values);
+		}
+		for (const auto &pattern : columnOrder)
+		{
+			auto it = gpData.values.find(pattern);
+			columns.emplace_back(&pattern, it != gpData.values.end() ? &it->second : &missing);
+		}
+		return columns;
+	};
+
 	// Determine column headers
 	if (!headers.empty())
 	{
@@ -145,9 +233,9 @@ void write_match_data_to_file(const std::vector<MatchData> &data,
 	}
 	else if (!data.empty())
 	{
-		for (const auto &[pattern, _] : data.front().values)
+		for (const auto &[pattern, _] : columns_of(data.front()))
 		{
-			outFile << pattern << "\t\t";
+			outFile << *pattern << "\t\t";
 		}
 	}
 	outFile << std::endl;
@@ -155,21 +243,22 @@ void write_match_data_to_file(const std::vector<MatchData> &data,
 	// Write the values for each file
 	for (const auto &gpData : data)
 	{
+		const auto columns = columns_of(gpData);
 		size_t maxRows = 0;
-		for (const auto &[_, values] : gpData.values)
+		for (const auto &[_, values] : columns)
 		{
-			maxRows = std::max(maxRows, values.size());
+			maxRows = std::max(maxRows, values->size());
 		}
 
 		for (size_t i = 0; i < maxRows; ++i)
 		{
 			outFile << gpData.fileName << "\t\t"; // Write file name in #config column
 
-			for (const auto &[_, values] : gpData.values)
+			for (const auto &[_, values] : columns)
 			{
-				if (i < values.size())
+				if (i < values->size())
 				{
-					outFile << values[i] << "\t\t"; // Write the value
+					outFile << (*values)[i] << "\t\t"; // Write the value
 				}
 				else
 				{
@@ -199,11 +288,15 @@ void write_match_data_to_file(const std::vector<MatchData> &data,
  * @param[in] filename Name of the file to write the data to.
  * @param[in] headers Optional vector of strings representing headers to be written at the top of the file.
  * @param[in] extraInfo Optional vector of strings representing extra information to be written before headers.
+ * @param[in] errors Optional error of every second value, written as a third column.
+ *
+ * @return True if the whole file was written, false otherwise.
  */
-void write_pair_data_to_file(const std::vector<std::pair<int, double>> &data,
+bool write_pair_data_to_file(const std::vector<std::pair<int, double>> &data,
 														 const std::string &filename,
 														 const std::vector<std::string> &headers = {},
-														 const std::vector<std::string> &extraInfo = {})
+														 const std::vector<std::string> &extraInfo = {},
+														 const std::vector<double> &errors = {})
 {
 	std::ofstream outfile(filename); // Open the file for writing
 
@@ -211,7 +304,7 @@ void write_pair_data_to_file(const std::vector<std::pair<int, double>> &data,
 	if (!outfile)
 	{
 		std::cerr << "Error opening file for writing: " << filename << std::endl;
-		return;
+		return false;
 	}
 
 	// Write extra information
@@ -237,13 +330,22 @@ void write_pair_data_to_file(const std::vector<std::pair<int, double>> &data,
 	}
 
 	// Write the data to the file
-	for (const auto &pair : data)
+	for (size_t i = 0; i < data.size(); ++i)
 	{
-		outfile << pair.first << "\t\t" << pair.second << std::endl;
+		outfile << data[i].first << "\t\t" << data[i].second;
+		if (i < errors.size())
+			outfile << "\t\t" << errors[i];
+		outfile << std::endl;
 	}
 
 	// Close the file
 	outfile.close();
+	if (!outfile)
+	{
+		std::cerr << "Error writing file: " << filename << std::endl;
+		return false;
+	}
+	return true;
 }
 
 
@@ -391,7 +493,7 @@ bool sort_column_in_file(const std::string &inputFile, const std::string &output
 
 
 /**
- * @brief Reads a specified column from a file as a vector of doubles.
+ * @brief Reads a specified column from a file as a vector of doubles (or of T, e.g. float storage).
  *
  * @param[in] filename Path to the file to read.
  * @param[in] columnIndex Index of the column to read (0-based).
@@ -402,9 +504,10 @@ bool sort_column_in_file(const std::string &inputFile, const std::string &output
  * each row. If the file is empty or cannot be opened, an empty vector is returned.
  * If the specified column index is out of bounds, an empty vector is returned.
  */
-std::vector<double> readColumn(const std::string &filename, int columnIndex)
+template <typename T = double>
+std::vector<T> readColumn(const std::string &filename, int columnIndex)
 {
-	std::vector<double> columnData;
+	std::vector<T> columnData;
 	std::ifstream file(filename);
 
 	if (!file)
@@ -425,7 +528,7 @@ std::vector<double> readColumn(const std::string &filename, int columnIndex)
 		{
 			if (currentColumn == columnIndex)
 			{
-				columnData.push_back(value);
+				columnData.push_back(static_cast<T>(value));
 				break;
 			}
 			currentColumn++;
@@ -438,6 +541,97 @@ std::vector<double> readColumn(const std::string &filename, int columnIndex)
 
 
 
+/**
+ * @brief Streams a specified column of a text file to a callback, one value at a time.
+ *
+ * @param[in] filename Path to the file to read.
+ * @param[in] columnIndex Index of the column to read (0-based).
+ * @param[in] consumer Function called with every value of the column, in file order.
+ *
+ * @return The number of values read, or -1 if the file cannot be opened.
+ *
+ * @details Same parsing rules as readColumn, without holding the column in memory.
+ */
+long long stream_column(const std::string &filename, int columnIndex, const std::function<void(double)> &consumer)
+{
+	std::ifstream file(filename);
+	if (!file)
+	{
+		std::cerr << "Error: Cannot open file " << filename << "\n";
+		return -1;
+	}
+
+	long long count = 0;
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream ss(line);
+		double value;
+		int currentColumn = 0;
+
+		// Read up to the desired column
+		while (ss >> value)
+		{
+			if (currentColumn == columnIndex)
+			{
+				consumer(value);
+				count++;
+				break;
+			}
+			currentColumn++;
+		}
+	}
+	return count;
+}
+
+/**
+ * @brief Streams a binary column file (raw native doubles) to a callback in chunks.
+ *
+ * @param[in] filename Path to the binary file to read.
+ * @param[in] consumer Function called with every value of the file, in file order.
+ * @param[in] chunkSize Number of values read from disk at a time.
+ *
+ * @return The number of values read, or -1 if the file cannot be opened.
+ */
+long long stream_binary_column(const std::string &filename, const std::function<void(double)> &consumer, std::size_t chunkSize = 1 << 16)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		std::cerr << "Error: Cannot open file " << filename << "\n";
+		return -1;
+	}
+
+	long long count = 0;
+	std::vector<double> chunk(chunkSize);
+	while (file)
+	{
+		file.read(reinterpret_cast<char *>(chunk.data()), chunk.size() * sizeof(double));
+		std::size_t nRead = static_cast<std::size_t>(file.gcount()) / sizeof(double);
+		for (std::size_t i = 0; i < nRead; ++i)
+		{
+			consumer(chunk[i]);
+		}
+		count += nRead;
+	}
+	return count;
+}
+
+// Writes a column of doubles as raw native doubles, readable by stream_binary_column
+bool write_binary_column(const std::vector<double> &data, const std::string &filename)
+{
+	std::ofstream outFile(filename, std::ios::binary);
+	if (!outFile)
+	{
+		std::cerr << "Error: Cannot open output file " << filename << "\n";
+		return false;
+	}
+	outFile.write(reinterpret_cast<const char *>(data.data()), data.size() * sizeof(double));
+	return static_cast<bool>(outFile);
+}
+
+
+
 /**
  * @brief Function to remove a file.
  *
@@ -0,0 +1,496 @@
+#ifndef FITTING_HPP
+#define FITTING_HPP
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <array>
+#include <span>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+
+#include "stattools.hpp"
+
+// Forward-mode dual number: a value and its derivatives with respect to NP fit parameters
+template <int NP>
+struct Dual
+{
+    double v = 0.0;
+    std::array<double, NP> d{};
+
+    Dual() = default;
+    Dual(double value) : v(value) {}
+
+    // The k-th fit parameter, seeded with derivative 1 in direction k
+    static Dual parameter(double value, int k)
+    {
+        Dual x(value);
+        x.d[k] = 1.0;
+        return x;
+    }
+};
+
+template <int NP> Dual<NP> operator+(Dual<NP> a, const Dual<NP> &b) { a.v += b.v; for (int k = 0; k < NP; ++k) a.d[k] += b.d[k]; return a; }
+template <int NP> Dual<NP> operator-(Dual<NP> a, const Dual<NP> &b) { a.v -= b.v; for (int k = 0; k < NP; ++k) a.d[k] -= b.d[k]; return a; }
+template <int NP> Dual<NP> operator-(Dual<NP> a) { a.v = -a.v; for (int k = 0; k < NP; ++k) a.d[k] = -a.d[k]; return a; }
+template <int NP> Dual<NP> operator*(const Dual<NP> &a, const Dual<NP> &b)
+{
+    Dual<NP> r(a.v * b.v);
+    for (int k = 0; k < NP; ++k) r.d[k] = a.d[k] * b.v + a.v * b.d[k];
+    return r;
+}
+template <int NP> Dual<NP> operator/(const Dual<NP> &a, const Dual<NP> &b)
+{
+    Dual<NP> r(a.v / b.v);
+    for (int k = 0; k < NP; ++k) r.d[k] = (a.d[k] - r.v * b.d[k]) / b.v;
+    return r;
+}
+template <int NP> Dual<NP> operator+(const Dual<NP> &a, double b) { return a + Dual<NP>(b); }
+template <int NP> Dual<NP> operator+(double a, const Dual<NP> &b) { return Dual<NP>(a) + b; }
+template <int NP> Dual<NP> operator-(const Dual<NP> &a, double b) { return a - Dual<NP>(b); }
+template <int NP> Dual<NP> operator-(double a, const Dual<NP> &b) { return Dual<NP>(a) - b; }
+template <int NP> Dual<NP> operator*(const Dual<NP> &a, double b) { return a * Dual<NP>(b); }
+template <int NP> Dual<NP> operator*(double a, const Dual<NP> &b) { return Dual<NP>(a) * b; }
+template <int NP> Dual<NP> operator/(const Dual<NP> &a, double b) { return a / Dual<NP>(b); }
+template <int NP> Dual<NP> operator/(double a, const Dual<NP> &b) { return Dual<NP>(a) / b; }
+
+// Elementary functions f(a) with derivative f'(a) a.d
+template <int NP> Dual<NP> chain(const Dual<NP> &a, double value, double derivative)
+{
+    Dual<NP> r(value);
+    for (int k = 0; k < NP; ++k) r.d[k] = derivative * a.d[k];
+    return r;
+}
+template <int NP> Dual<NP> exp(const Dual<NP> &a) { double e = std::exp(a.v); return chain(a, e, e); }
+template <int NP> Dual<NP> log(const Dual<NP> &a) { return chain(a, std::log(a.v), 1.0 / a.v); }
+template <int NP> Dual<NP> sqrt(const Dual<NP> &a) { double s = std::sqrt(a.v); return chain(a, s, 0.5 / s); }
+template <int NP> Dual<NP> pow(const Dual<NP> &a, double n) { return chain(a, std::pow(a.v, n), n * std::pow(a.v, n - 1.0)); }
+template <int NP> Dual<NP> sin(const Dual<NP> &a) { return chain(a, std::sin(a.v), std::cos(a.v)); }
+template <int NP> Dual<NP> cos(const Dual<NP> &a) { return chain(a, std::cos(a.v), -std::sin(a.v)); }
+
+
+// LMParams struct with the stopping criteria of the Levenberg-Marquardt solver
+struct LMParams
+{
+    int maxIterations = 200;    // Maximum number of accepted or rejected steps
+    double lambda0 = 1e-3;      // Initial damping
+    double tolerance = 1e-10;   // Relative change of chi^2 (or of the parameters) below which the fit has converged
+};
+
+// FitResult struct holding the outcome of one least-squares fit
+template <int NP>
+struct FitResult
+{
+    std::array<double, NP> params{};
+    double chi2 = std::numeric_limits<double>::quiet_NaN();
+    int dof = 0;
+    int iterations = 0;
+    bool converged = false;
+};
+
+// Solves the NP x NP system A x = b in place by Gaussian elimination with partial pivoting
+template <int NP>
+bool solve_linear_system(std::array<double, NP * NP> &A, std::array<double, NP> &b)
+{
+    for (int col = 0; col < NP; ++col)
+    {
+        int pivot = col;
+        for (int row = col + 1; row < NP; ++row)
+            if (std::abs(A[row * NP + col]) > std::abs(A[pivot * NP + col]))
+                pivot = row;
+        if (A[pivot * NP + col] == 0.0)
+            return false;
+        if (pivot != col)
+        {
+            for (int k = 0; k < NP; ++k)
+                std::swap(A[col * NP + k], A[pivot * NP + k]);
+            std::swap(b[col], b[pivot]);
+        }
+        for (int row = col + 1; row < NP; ++row)
+        {
+            double f = A[row * NP + col] / A[col * NP + col];
+            for (int k = col; k < NP; ++k)
+                A[row * NP + k] -= f * A[col * NP + k];
+            b[row] -= f * b[col];
+        }
+    }
+    for (int row = NP - 1; row >= 0; --row)
+    {
+        for (int k = row + 1; k < NP; ++k)
+            b[row] -= A[row * NP + k] * b[k];
+        b[row] /= A[row * NP + row];
+    }
+    return true;
+}
+
+/**
+ * @brief Levenberg-Marquardt minimization of chi^2 = sum_i r_i^2 for a user-supplied residual function.
+ *
+ * @param[in] residuals Callable (params, r, J) filling the residuals r[i] = (model_i - y_i) / sigma_i
+ *                      and, if J is not empty, the Jacobian J[i * NP + k] = d r_i / d params_k.
+ * @param[in] nPoints Number of residuals.
+ * @param[in] start Starting parameters (e.g. the central fit for a jackknife sample).
+ * @param[in] lm Stopping criteria.
+ *
+ * @return The best parameters found, with chi^2 and convergence information.
+ *
+ * @details The damped normal equations (J^T J + lambda diag(J^T J)) delta = -J^T r
+ * are solved at each step; lambda is divided by 10 after an accepted step and
+ * multiplied by 10 after a rejected one. The fit has converged only when an accepted
+ * step changes chi^2 or the parameters by less than the tolerance; running out of
+ * damping (lambda > 1e12), of iterations or a singular system leaves converged false.
+ */
+template <int NP, typename Residuals>
+FitResult<NP> levenberg_marquardt(const Residuals &residuals, std::size_t nPoints,
+                                  const std::array<double, NP> &start, const LMParams &lm = {})
+{
+    FitResult<NP> result;
+    result.params = start;
+    result.dof = static_cast<int>(nPoints) - NP;
+
+    std::vector<double> r(nPoints), rTrial(nPoints), J(nPoints * NP);
+    auto chi2_of = [](const std::vector<double> &res)
+    {
+        double chi2 = 0.0;
+        for (double x : res)
+            chi2 += x * x;
+        return chi2;
+    };
+
+    residuals(result.params, std::span<double>(r), std::span<double>(J));
+    double chi2 = chi2_of(r);
+    double lambda = lm.lambda0;
+
+    for (result.iterations = 0; result.iterations < lm.maxIterations; ++result.iterations)
+    {
+        // Normal equations J^T J and gradient J^T r
+        std::array<double, NP * NP> JTJ{};
+        std::array<double, NP> JTr{};
+        for (std::size_t i = 0; i < nPoints; ++i)
+        {
+            const double *row = &J[i * NP];
+            for (int a = 0; a < NP; ++a)
+            {
+                JTr[a] += row[a] * r[i];
+                for (int b = 0; b < NP; ++b)
+                    JTJ[a * NP + b] += row[a] * row[b];
+            }
+        }
+
+        std::array<double, NP * NP> A = JTJ;
+        std::array<double, NP> delta;
+        for (int a = 0; a < NP; ++a)
+        {
+            A[a * NP + a] += lambda * std::max(JTJ[a * NP + a], 1e-300);
+            delta[a] = -JTr[a];
+        }
+        if (!solve_linear_system<NP>(A, delta))
+            break;
+
+        std::array<double, NP> trial;
+        double stepSize = 0.0, paramSize = 0.0;
+        for (int a = 0; a < NP; ++a)
+        {
+            trial[a] = result.params[a] + delta[a];
+            stepSize += delta[a] * delta[a];
+            paramSize += result.params[a] * result.params[a];
+        }
+
+        residuals(trial, std::span<double>(rTrial), std::span<double>());
+        double chi2Trial = chi2_of(rTrial);
+        if (std::isfinite(chi2Trial) && chi2Trial <= chi2)
+        {
+            bool small = (chi2 - chi2Trial) <= lm.tolerance * std::max(chi2, 1e-300) ||
+                         std::sqrt(stepSize) <= lm.tolerance * (std::sqrt(paramSize) + lm.tolerance);
+            result.params = trial;
+            chi2 = chi2Trial;
+            lambda = std::max(lambda / 10.0, 1e-12);
+            if (small)
+            {
+                result.converged = true;
+                break;
+            }
+            residuals(result.params, std::span<double>(r), std::span<double>(J));
+        }
+        else
+        {
+            lambda *= 10.0;
+            if (lambda > 1e12)
+            {
+                // No downhill step even with maximal damping: the fit stalled, which does not prove a minimum
+                break;
+            }
+        }
+    }
+
+    result.chi2 = chi2;
+    return result;
+}
+
+/**
+ * @brief Fits model(x, params) to the points (x_i, y_i +- sigma_i) with Levenberg-Marquardt.
+ *
+ * @param[in] model Callable model(x, p) generic in the parameter type, e.g.
+ *                  [](double x, const auto &p) { return p[0] / (x + p[1] * p[1]); }.
+ *                  If it also provides model.gradient(x, p, grad) filling grad[k] = d model / d p_k,
+ *                  the analytic derivatives are used; otherwise they come from Dual numbers.
+ * @param[in] x Abscissae.
+ * @param[in] y Values to be fitted.
+ * @param[in] sigma Errors of the values.
+ * @param[in] start Starting parameters.
+ * @param[in] lm Stopping criteria.
+ *
+ * @return The fitted parameters with chi^2 and convergence information.
+ */
+template <int NP, typename Model>
+FitResult<NP> lm_fit(const Model &model,
+                     std::span<const double> x,
+                     std::span<const double> y,
+                     std::span<const double> sigma,
+                     const std::array<double, NP> &start,
+                     const LMParams &lm = {})
+{
+    auto residuals = [&](const std::array<double, NP> &p, std::span<double> r, std::span<double> J)
+    {
+        if (J.empty())
+        {
+            for (std::size_t i = 0; i < x.size(); ++i)
+                r[i] = (model(x[i], p) - y[i]) / sigma[i];
+            return;
+        }
+
+        if constexpr (requires(std::array<double, NP> &g) { model.gradient(x[0], p, g); })
+        {
+            std::array<double, NP> grad;
+            for (std::size_t i = 0; i < x.size(); ++i)
+            {
+                r[i] = (model(x[i], p) - y[i]) / sigma[i];
+                model.gradient(x[i], p, grad);
+                for (int k = 0; k < NP; ++k)
+                    J[i * NP + k] = grad[k] / sigma[i];
+            }
+        }
+        else
+        {
+            std::array<Dual<NP>, NP> pDual;
+            for (int k = 0; k < NP; ++k)
+                pDual[k] = Dual<NP>::parameter(p[k], k);
+            for (std::size_t i = 0; i < x.size(); ++i)
+            {
+                Dual<NP> m = model(x[i], pDual);
+                r[i] = (m.v - y[i]) / sigma[i];
+                for (int k = 0; k < NP; ++k)
+                    J[i * NP + k] = m.d[k] / sigma[i];
+            }
+        }
+    };
+
+    return levenberg_marquardt<NP>(residuals, x.size(), start, lm);
+}
+
+
+// Refined Gribov-Zwanziger form of the gluon propagator D(p^2) = Z (p^2 + M1^2) / (p^4 + M2^2 p^2 + M3^4)
+struct PropagatorModel
+{
+    // p = {Z, M1^2, M2^2, M3^4}
+    template <typename P>
+    auto operator()(double p2, const P &p) const
+    {
+        return p[0] * (p2 + p[1]) / (p2 * p2 + p[2] * p2 + p[3]);
+    }
+
+    void gradient(double p2, const std::array<double, 4> &p, std::array<double, 4> &grad) const
+    {
+        double den = p2 * p2 + p[2] * p2 + p[3];
+        double num = p2 + p[1];
+        grad[0] = num / den;
+        grad[1] = p[0] / den;
+        grad[2] = -p[0] * num * p2 / (den * den);
+        grad[3] = -p[0] * num / (den * den);
+    }
+};
+
+
+// JackknifeFit struct holding a central fit and its refits on every jackknife sample
+template <int NP>
+struct JackknifeFit
+{
+    std::vector<double> x, y, sigma;             // Fitted points: abscissa, central mean and its jackknife error
+    FitResult<NP> central;                       // Fit to the central means
+    std::vector<FitResult<NP>> samples;          // Fit to each jackknife sample
+    std::array<double, NP> errors{};             // Jackknife errors of the parameters, from the converged refits only
+    int failed = 0;                              // Number of refits that did not converge (left out of the errors)
+};
+
+/**
+ * @brief Fits a model to the means of several Monte Carlo series and estimates parameter errors by jackknife.
+ *
+ * @param[in] model Model as for lm_fit, evaluated at x.
+ * @param[in] x Abscissa of each series (e.g. the momentum squared).
+ * @param[in] series One Monte Carlo series per abscissa, all of the same length (bin them first if needed).
+ * @param[in] start Starting parameters of the central fit.
+ * @param[in] numThreads Number of threads refitting jackknife samples (0 for all hardware threads).
+ * @param[in] lm Stopping criteria.
+ *
+ * @return The central fit, every jackknife refit and the parameter errors.
+ *
+ * @details Points whose mean or error is not finite (e.g. missing momenta) are skipped.
+ * The central fit uses the means and jackknife errors of each series. The i-th refit
+ * uses the jackknife means without configuration i (jack_means), with the same errors,
+ * and starts from the central parameters, so it usually converges in a few steps.
+ * Refits are distributed over the threads; each writes only its own result.
+ *
+ * Refits that did not converge are left out of the errors and counted in failed; the
+ * jackknife sum over the remaining n samples is rescaled by N/n. If no refit converged
+ * the errors are NaN.
+ */
+template <int NP, typename Model, typename Series>
+JackknifeFit<NP> jackknife_fit(const Model &model,
+                               const std::vector<double> &x,
+                               const std::vector<Series> &series,
+                               const std::array<double, NP> &start,
+                               int numThreads = 0,
+                               const LMParams &lm = {})
+{
+    JackknifeFit<NP> fit;
+    if (series.empty() || series.size() != x.size())
+    {
+        std::cerr << "Error: jackknife_fit needs one series per abscissa.\n";
+        return fit;
+    }
+    const std::size_t nConfigs = series[0].size();
+
+    // Central values and errors of the usable points
+    std::vector<std::size_t> used;
+    for (std::size_t i = 0; i < series.size(); ++i)
+    {
+        if (series[i].size() != nConfigs)
+        {
+            std::cerr << "Error: jackknife_fit needs series of equal length.\n";
+            return fit;
+        }
+        double m = mean(series[i]);
+        double err = jack_error(series[i]);
+        if (std::isfinite(m) && std::isfinite(err) && err > 0.0)
+        {
+            used.push_back(i);
+            fit.x.push_back(x[i]);
+            fit.y.push_back(m);
+            fit.sigma.push_back(err);
+        }
+    }
+    const std::size_t nPoints = used.size();
+    if (nPoints < static_cast<std::size_t>(NP) || nConfigs < 2)
+    {
+        std::cerr << "Error: not enough points or configurations for a " << NP << "-parameter fit.\n";
+        return fit;
+    }
+
+    fit.central = lm_fit<NP>(model, fit.x, fit.y, fit.sigma, start, lm);
+
+    // Jackknife means, configuration-major so that each refit reads one contiguous row
+    std::vector<double> jackMeans(nConfigs * nPoints), column(nConfigs);
+    for (std::size_t p = 0; p < nPoints; ++p)
+    {
+        jack_means(series[used[p]], std::span<double>(column));
+        for (std::size_t c = 0; c < nConfigs; ++c)
+            jackMeans[c * nPoints + p] = column[c];
+    }
+
+    fit.samples.resize(nConfigs);
+    std::atomic<std::size_t> nextSample{0};
+    auto worker = [&]()
+    {
+        for (std::size_t c = nextSample++; c < nConfigs; c = nextSample++)
+        {
+            std::span<const double> y(jackMeans.data() + c * nPoints, nPoints);
+            fit.samples[c] = lm_fit<NP>(model, fit.x, y, fit.sigma, fit.central.params, lm);
+        }
+    };
+
+    if (numThreads <= 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    numThreads = std::max(1, std::min<int>(numThreads, static_cast<int>(nConfigs)));
+    std::vector<std::thread> pool;
+    for (int t = 0; t < numThreads; ++t)
+        pool.emplace_back(worker);
+    for (auto &t : pool)
+        t.join();
+
+    for (const auto &s : fit.samples)
+        fit.failed += s.converged ? 0 : 1;
+    const std::size_t nConverged = nConfigs - fit.failed;
+    if (fit.failed > 0)
+    {
+        std::cerr << "Warning: " << fit.failed << " of " << nConfigs << " jackknife refits did not converge and are left out of the errors.\n";
+    }
+    if (!fit.central.converged)
+    {
+        std::cerr << "Warning: the central fit did not converge.\n";
+    }
+
+    // sigma^2 = (N-1)/N sum_i (p_i - mean p)^2, the sum over the n converged refits scaled by N/n
+    for (int k = 0; k < NP; ++k)
+    {
+        if (nConverged == 0)
+        {
+            fit.errors[k] = std::numeric_limits<double>::quiet_NaN();
+            continue;
+        }
+        double m = 0.0;
+        for (const auto &s : fit.samples)
+            if (s.converged)
+                m += s.params[k];
+        m /= nConverged;
+        double sumsq = 0.0;
+        for (const auto &s : fit.samples)
+            if (s.converged)
+                sumsq += (s.params[k] - m) * (s.params[k] - m);
+        fit.errors[k] = std::sqrt(sumsq * (nConfigs - 1) / nConverged);
+    }
+
+    return fit;
+}
+
+/**
+ * @brief Writes a jackknife fit: parameters, errors and chi^2 as header lines, then the fitted points and the model.
+ *
+ * @param[in] fit Result of jackknife_fit.
+ * @param[in] model Model that was fitted, evaluated at every point for the last column.
+ * @param[in] paramNames Name of each parameter.
+ * @param[in] filename Name of the file to write the data to.
+ * @param[in] extraInfo Optional vector of strings representing extra information to be written before headers.
+ */
+template <int NP, typename Model>
+void write_fit_to_file(const JackknifeFit<NP> &fit,
+                       const Model &model,
+                       const std::vector<std::string> &paramNames,
+                       const std::string &filename,
+                       const std::vector<std::string> &extraInfo = {})
+{
+    std::ofstream outfile(filename);
+    if (!outfile)
+    {
+        std::cerr << "Error opening file for writing: " << filename << std::endl;
+        return;
+    }
+
+    for (const auto &info : extraInfo)
+        outfile << info << "\n";
+    outfile << "# chi2/dof: " << fit.central.chi2 / std::max(fit.central.dof, 1)
+            << " (dof = " << fit.central.dof << ")" << (fit.central.converged ? "" : " NOT CONVERGED") << "\n";
+    for (int k = 0; k < NP; ++k)
+        outfile << "# " << (k < static_cast<int>(paramNames.size()) ? paramNames[k] : "p" + std::to_string(k)) << ": " << fit.central.params[k] << " +- " << fit.errors[k] << "\n";
+    outfile << "# jackknife refits not converged (left out of the errors): " << fit.failed << " of " << fit.samples.size() << "\n"
+            << std::endl;
+
+    outfile << "#x\t\ty\t\terror\t\tfit" << std::endl;
+    for (std::size_t i = 0; i < fit.x.size(); ++i)
+        outfile << fit.x[i] << "\t\t" << fit.y[i] << "\t\t" << fit.sigma[i] << "\t\t" << model(fit.x[i], fit.central.params) << std::endl;
+}
+
+#endif // fitting.hpp
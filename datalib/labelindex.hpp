@@ -0,0 +1,452 @@
+#ifndef LABELINDEX_HPP
+#define LABELINDEX_HPP
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <sstream>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <iterator>
+#include <string_view>
+#include <functional>
+#include <charconv>
+#include <system_error>
+#include <filesystem>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "filehandler.hpp"
+#include "readahead.hpp"
+#include "momentum.hpp"
+
+namespace fs = std::filesystem;
+
+// Position of one labelled line inside a data file
+struct LabelLineOffset
+{
+	std::uint64_t offset; // Byte offset of the first character of the line
+	std::uint32_t length; // Length of the line without the newline
+};
+
+namespace labelindex_detail
+{
+	// Appends the bytes of a trivially copyable value (native byte order)
+	template <typename T>
+	void put(std::string &out, const T &x)
+	{
+		out.append(reinterpret_cast<const char *>(&x), sizeof(x));
+	}
+
+	// Reads a value at pos and advances it, false if fewer than sizeof(T) bytes are left
+	template <typename T>
+	bool get(const char *&pos, const char *end, T &x)
+	{
+		if (static_cast<std::size_t>(end - pos) < sizeof(x))
+			return false;
+		std::memcpy(&x, pos, sizeof(x));
+		pos += sizeof(x);
+		return true;
+	}
+
+	// Reads a length-prefixed string at pos and advances it
+	inline bool get_string(const char *&pos, const char *end, std::string_view &s)
+	{
+		std::uint32_t length = 0;
+		if (!get(pos, end, length) || static_cast<std::size_t>(end - pos) < length)
+			return false;
+		s = std::string_view(pos, length);
+		pos += length;
+		return true;
+	}
+
+	inline void put_string(std::string &out, std::string_view s)
+	{
+		put(out, static_cast<std::uint32_t>(s.size()));
+		out.append(s);
+	}
+
+	constexpr std::size_t lineBytes = sizeof(std::uint64_t) + sizeof(std::uint32_t); // Encoded size of one LabelLineOffset
+}
+
+// Label lines of one data file, valid as long as the size and modification time match
+struct FileLabelIndex
+{
+	std::uintmax_t size = 0;
+	long long mtime = 0;
+
+	/**
+	 * Encoded label lines, one record per key:
+	 *   <u32 key length> <key> <u32 number of lines> { <u64 offset> <u32 length> } ...
+	 *
+	 * The block is copied from and to the index file as it is, so files that did not
+	 * change cost one copy per run; only the lines of the requested keys are decoded.
+	 */
+	std::string lines;
+
+	// Appends the offsets of the lines with the given key
+	void find(const std::string &key, std::vector<LabelLineOffset> &offsets) const
+	{
+		const char *pos = lines.data(), *end = pos + lines.size();
+		std::string_view name;
+		std::uint32_t count = 0;
+		while (labelindex_detail::get_string(pos, end, name) && labelindex_detail::get(pos, end, count))
+		{
+			if (name == key)
+			{
+				for (std::uint32_t i = 0; i < count; ++i)
+				{
+					LabelLineOffset line;
+					labelindex_detail::get(pos, end, line.offset);
+					labelindex_detail::get(pos, end, line.length);
+					offsets.push_back(line);
+				}
+				return;
+			}
+			pos += count * labelindex_detail::lineBytes;
+		}
+	}
+
+	// Replaces the block with the lines recorded during a scan
+	void assign(const std::unordered_map<std::string, std::vector<LabelLineOffset>> &scanned)
+	{
+		lines.clear();
+		for (const auto &[key, offsets] : scanned)
+		{
+			labelindex_detail::put_string(lines, key);
+			labelindex_detail::put(lines, static_cast<std::uint32_t>(offsets.size()));
+			for (const auto &line : offsets)
+			{
+				labelindex_detail::put(lines, line.offset);
+				labelindex_detail::put(lines, line.length);
+			}
+		}
+	}
+
+	// True if the block is a sequence of complete records
+	bool valid() const
+	{
+		const char *pos = lines.data(), *end = pos + lines.size();
+		std::string_view name;
+		std::uint32_t count = 0;
+		while (pos < end)
+		{
+			if (!labelindex_detail::get_string(pos, end, name) || !labelindex_detail::get(pos, end, count) ||
+					static_cast<std::size_t>(end - pos) / labelindex_detail::lineBytes < count)
+				return false;
+			pos += count * labelindex_detail::lineBytes;
+		}
+		return true;
+	}
+};
+
+// LabelIndex struct mapping every line label (label plus momentum tuple) to byte offsets in each file
+struct LabelIndex
+{
+	std::map<std::string, FileLabelIndex> files; // Keyed by file path relative to the (first) data directory
+
+	/**
+	 * Binary format (native byte order):
+	 *   "LBLIDX02" <u64 number of files>
+	 *   per file: <u32 name length> <name> <u64 size> <i64 mtime> <u64 block length> <block of FileLabelIndex::lines>
+	 *
+	 * Loading reads the file once and copies each block without decoding its lines.
+	 * A missing or corrupt index (or one of another format) leaves the struct empty,
+	 * so that every file is scanned again.
+	 */
+	bool load(const std::string &indexFile)
+	{
+		files.clear();
+		std::ifstream in(indexFile, std::ios::binary);
+		if (!in)
+			return false;
+		const std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+		if (in.bad() || !parse(contents))
+		{
+			std::cerr << "Ignoring corrupt label index " << indexFile << std::endl;
+			files.clear();
+			return false;
+		}
+		return true;
+	}
+
+	bool save(const std::string &indexFile) const
+	{
+		std::string contents(magic, sizeof(magic));
+		labelindex_detail::put(contents, static_cast<std::uint64_t>(files.size()));
+		for (const auto &[name, file] : files)
+		{
+			labelindex_detail::put_string(contents, name);
+			labelindex_detail::put(contents, static_cast<std::uint64_t>(file.size));
+			labelindex_detail::put(contents, static_cast<std::int64_t>(file.mtime));
+			labelindex_detail::put(contents, static_cast<std::uint64_t>(file.lines.size()));
+			contents += file.lines;
+		}
+
+		// Write to a name unique to this process and call first, so that readers never see a partial
+		// index and concurrent runs on the same directory never write into each other's file
+		static std::atomic<unsigned long> counter{0};
+		const std::string tmpFile = indexFile + ".tmp." + std::to_string(::getpid()) + "." + std::to_string(counter++);
+		std::ofstream out(tmpFile, std::ios::binary);
+		out.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+		out.close();
+
+		std::error_code ec;
+		if (out)
+			fs::rename(tmpFile, indexFile, ec);
+		if (!out || ec)
+		{
+			std::cerr << "Error: Cannot write label index " << indexFile << std::endl;
+			fs::remove(tmpFile, ec);
+			return false;
+		}
+		return true;
+	}
+
+private:
+	static constexpr char magic[8] = {'L', 'B', 'L', 'I', 'D', 'X', '0', '2'};
+
+	// Reads the file records of an index, returns false on a wrong magic or any truncated record
+	bool parse(const std::string &contents)
+	{
+		const char *pos = contents.data(), *end = pos + contents.size();
+		if (contents.size() < sizeof(magic) || contents.compare(0, sizeof(magic), magic, sizeof(magic)) != 0)
+			return false;
+		pos += sizeof(magic);
+
+		std::uint64_t numFiles = 0;
+		if (!labelindex_detail::get(pos, end, numFiles))
+			return false;
+		for (std::uint64_t f = 0; f < numFiles; ++f)
+		{
+			std::string_view name;
+			std::uint64_t size = 0, blockLength = 0;
+			std::int64_t mtime = 0;
+			if (!labelindex_detail::get_string(pos, end, name) || !labelindex_detail::get(pos, end, size) ||
+					!labelindex_detail::get(pos, end, mtime) || !labelindex_detail::get(pos, end, blockLength) ||
+					static_cast<std::uint64_t>(end - pos) < blockLength)
+				return false;
+
+			FileLabelIndex &entry = files[std::string(name)];
+			entry.size = size;
+			entry.mtime = mtime;
+			entry.lines.assign(pos, blockLength);
+			pos += blockLength;
+			if (!entry.valid())
+				return false;
+		}
+		return pos == end;
+	}
+};
+
+// Normalized index key of a label and momentum, e.g. "GP_T 0 0 0 0"
+inline std::string label_index_key(const std::string &label, const MomentumTuple &momentum)
+{
+	return label + " " + std::to_string(momentum[0]) + " " + std::to_string(momentum[1]) + " " +
+				 std::to_string(momentum[2]) + " " + std::to_string(momentum[3]);
+}
+
+// Normalized index key of a pattern such as "GP_T 0  +0  0  0" (whitespace collapsed, integers in canonical form)
+inline std::string label_index_key(const std::string &pattern)
+{
+	std::istringstream ss(pattern);
+	std::string part, key;
+	while (ss >> part)
+	{
+		if (!key.empty())
+		{
+			const char *first = part.data() + (part.size() > 1 && part[0] == '+');
+			const char *last = part.data() + part.size();
+			int n = 0;
+			auto [ptr, ec] = std::from_chars(first, last, n);
+			if (ec == std::errc() && ptr == last)
+				part = std::to_string(n);
+		}
+		key += (key.empty() ? "" : " ") + part;
+	}
+	return key;
+}
+
+/**
+ * @brief Extracts pattern values using a persistent byte-offset index of the label lines.
+ *
+ * @param directoryPaths The directories containing the files to be processed; the index covers all of them.
+ * @param fileType The extension of the files to be processed.
+ * @param patterns Exact patterns of the form "LABEL p1 p2 p3 p4" (whitespace between parts is ignored).
+ * @param indexFile Path to the index file of the directories.
+ * @param ioParams Read-ahead parameters used for the files that have to be scanned.
+ * @param deduplicate If true, files duplicating the contents of another file are skipped (and not indexed).
+ * @param onFile Optional function called with the values of every file; all files are parsed on the calling thread (reader 0).
+ *
+ * @return A vector of MatchData structs, as returned by extract_pattern_values_from_file.
+ *
+ * @details Files that are new or changed since the index was written (size or
+ * modification time differ) are scanned in full, and every "LABEL int int int int value"
+ * line is recorded in the index while the patterns are extracted. For indexed files
+ * only the lines of the requested patterns are read, with positioned reads. The index
+ * is rewritten whenever a file had to be scanned or was removed.
+ *
+ * Scanned and indexed files use the same matching rule: a line matches a pattern when
+ * their normalized keys (see label_index_key) are equal, whatever the spacing of either.
+ */
+std::vector<MatchData> extract_pattern_values_indexed(const std::vector<std::string> &directoryPaths,
+																											const std::string &fileType,
+																											const std::vector<std::string> &patterns,
+																											const std::string &indexFile,
+																											const ReadAheadParams &ioParams = {},
+																											bool deduplicate = true,
+																											const std::function<void(const MatchData &, int)> &onFile = {})
+{
+	LabelIndex index;
+	index.load(indexFile);
+	bool indexChanged = false;
+
+	std::vector<std::string> keys;
+	std::unordered_map<std::string, std::vector<size_t>> patternsOfKey;
+	for (size_t p = 0; p < patterns.size(); ++p)
+	{
+		keys.push_back(label_index_key(patterns[p]));
+		patternsOfKey[keys.back()].push_back(p);
+	}
+
+	// Files are indexed by their path relative to the first directory, i.e. by their name for that directory
+	fs::path base = directoryPaths.empty() ? fs::path() : fs::path(directoryPaths.front());
+	if (!base.has_filename())
+		base = base.parent_path();
+	auto index_name = [&base](const fs::path &path)
+	{ return path.lexically_relative(base).string(); };
+
+	// Split the directories into indexed files and files to be scanned
+	std::vector<fs::path> toScan, indexed;
+	std::map<std::string, FileLabelIndex> present;
+	for (const auto &path : list_data_files(directoryPaths, fileType, deduplicate))
+	{
+		std::string name = index_name(path);
+		std::error_code ec;
+		std::uintmax_t size = fs::file_size(path, ec);
+		long long mtime = static_cast<long long>(fs::last_write_time(path, ec).time_since_epoch().count());
+
+		auto it = index.files.find(name);
+		if (it != index.files.end() && it->second.size == size && it->second.mtime == mtime)
+		{
+			indexed.push_back(path);
+			present[name] = std::move(it->second);
+		}
+		else
+		{
+			toScan.push_back(path);
+			present[name].size = size;
+			present[name].mtime = mtime;
+		}
+	}
+	indexChanged = !toScan.empty() || present.size() != index.files.size();
+	index.files = std::move(present);
+
+	std::vector<MatchData> gpDataList;
+	auto store = [&](MatchData &&fileData, const fs::path &path)
+	{
+		if (match_data_has_values(fileData))
+		{
+			if (onFile)
+				onFile(fileData, 0);
+			gpDataList.push_back(std::move(fileData));
+		}
+		else
+		{
+			std::cerr << "No values found for the specified patterns in file: " << path << std::endl;
+		}
+	};
+
+	// Targeted reads of the indexed lines
+	std::string line, label;
+	MomentumTuple momentum;
+	double value;
+	std::vector<LabelLineOffset> offsets;
+	for (const auto &path : indexed)
+	{
+		const FileLabelIndex &fileIndex = index.files[index_name(path)];
+		int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			std::cerr << "Error opening file: " << path << std::endl;
+			continue;
+		}
+
+		MatchData fileData;
+		fileData.fileName = path.filename().string();
+		for (size_t p = 0; p < patterns.size(); ++p)
+		{
+			fileData.values[patterns[p]] = {};
+			offsets.clear();
+			fileIndex.find(keys[p], offsets);
+			for (const auto &pos : offsets)
+			{
+				line.resize(pos.length);
+				if (::pread(fd, &line[0], pos.length, static_cast<off_t>(pos.offset)) == static_cast<ssize_t>(pos.length) &&
+						parse_momentum_line(line.data(), line.data() + line.size(), label, momentum, value) &&
+						label_index_key(label, momentum) == keys[p])
+				{
+					fileData.values[patterns[p]].push_back(value);
+				}
+			}
+		}
+		::close(fd);
+		store(std::move(fileData), path);
+	}
+
+	// Full scan of new or changed files, recording the label lines on the way
+	read_ahead_files(toScan, ioParams, [&](FileBuffer &buf)
+									 {
+		if (!buf.ok)
+		{
+			std::cerr << "Error opening file: " << buf.path << std::endl;
+			return;
+		}
+
+		std::unordered_map<std::string, std::vector<LabelLineOffset>> scanned;
+		MatchData fileData;
+		fileData.fileName = buf.path.filename().string();
+		for (const auto &pattern : patterns)
+		{
+			fileData.values[pattern] = {};
+		}
+
+		std::string label;
+		MomentumTuple momentum;
+		double value;
+		const char *begin = buf.data.data();
+		const char *end = begin + buf.data.size();
+		for (const char *pos = begin; pos < end;)
+		{
+			const char *eol = std::find(pos, end, '\n');
+			if (parse_momentum_line(pos, eol, label, momentum, value))
+			{
+				std::string key = label_index_key(label, momentum);
+				auto matched = patternsOfKey.find(key);
+				if (matched != patternsOfKey.end())
+				{
+					for (size_t p : matched->second)
+						fileData.values[patterns[p]].push_back(value);
+				}
+				scanned[std::move(key)].push_back(
+						{static_cast<std::uint64_t>(pos - begin), static_cast<std::uint32_t>(eol - pos)});
+			}
+			pos = eol + 1;
+		}
+		index.files[index_name(buf.path)].assign(scanned);
+		store(std::move(fileData), buf.path); });
+
+	if (indexChanged)
+	{
+		index.save(indexFile);
+	}
+	return gpDataList;
+}
+
+#endif // labelindex.hpp
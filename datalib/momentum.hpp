@@ -0,0 +1,546 @@
+#ifndef MOMENTUM_HPP
+#define MOMENTUM_HPP
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <array>
+#include <span>
+#include <map>
+#include <limits>
+#include <algorithm>
+#include <cstdlib>
+#include <cctype>
+#include <charconv>
+#include <system_error>
+#include <cmath>
+#include <functional>
+
+#include "filehandler.hpp"
+#include "readahead.hpp"
+#include "binaryio.hpp"
+
+// Four-component lattice momentum as written in the .out files (e.g. "GP_T 0  0  0  0")
+using MomentumTuple = std::array<int, 4>;
+
+// MomentumPattern struct describing a pattern such as "GP_T * * * *" or "GP_L * 0 0 0"
+struct MomentumPattern
+{
+	std::string pattern;				 // Original pattern string
+	std::string label;					 // Line label, e.g. GP_T
+	std::array<bool, 4> wildcard; // True if the component matches any integer
+	MomentumTuple fixed;				 // Required value of the non-wildcard components
+};
+
+// MomentumTensor struct storing one observable as a dense config x momentum array
+struct MomentumTensor
+{
+	std::string pattern;									 // Pattern the tensor was extracted with
+	std::vector<int> configs;							 // Configuration number of each row, in ascending order
+	std::vector<MomentumTuple> momenta;		 // Momentum tuple of each column, in ascending order
+	std::map<MomentumTuple, size_t> index; // Maps a momentum tuple to its column
+	std::vector<double> values;						 // Momentum-major storage: values[m * configs.size() + c], NaN if missing
+	std::vector<int> multiplicity;				 // Momenta averaged into each column (1 without orbit averaging)
+
+	size_t num_configs() const { return configs.size(); }
+	size_t num_momenta() const { return momenta.size(); }
+
+	double at(size_t config, size_t momentum) const { return values[momentum * configs.size() + config]; }
+
+	// Returns the Monte Carlo series of one momentum, ready for the routines in stattools.hpp
+	std::vector<double> series(size_t momentum) const
+	{
+		auto first = values.begin() + momentum * configs.size();
+		return std::vector<double>(first, first + configs.size());
+	}
+
+	// Same as series() without the copy: a view into the tensor storage
+	std::span<const double> series_view(size_t momentum) const
+	{
+		return std::span<const double>(values.data() + momentum * configs.size(), configs.size());
+	}
+};
+
+// Symmetry group whose orbits of momenta are averaged during ingest
+enum class MomentumSymmetry
+{
+	None,				// Every momentum is kept
+	Hypercubic, // H(4): permutations and sign flips of all four components (up to 384 momenta per orbit)
+	Spatial			// O_h on the three spatial components, plus the sign of the time component (up to 96 momenta per orbit)
+};
+
+inline std::string symmetry_name(MomentumSymmetry symmetry)
+{
+	switch (symmetry)
+	{
+	case MomentumSymmetry::Hypercubic:
+		return "hypercubic";
+	case MomentumSymmetry::Spatial:
+		return "spatial";
+	default:
+		return "none";
+	}
+}
+
+// OrbitParams struct selecting the symmetry orbits and the momentum cuts applied during ingest
+struct OrbitParams
+{
+	MomentumSymmetry symmetry = MomentumSymmetry::None;
+	int timeDirection = 3;				// Component holding the time momentum (Spatial symmetry)
+	double cylinderRadius = -1.0; // Keep momenta within this distance of the diagonal, in units of the integer momentum (negative: no cut)
+	double coneAngle = -1.0;			// Keep momenta within this angle of the diagonal, in degrees (negative: no cut)
+};
+
+/**
+ * @brief Maps a momentum tuple to the representative of its symmetry orbit.
+ *
+ * @details Hypercubic: the absolute values of the components, sorted in descending
+ * order. Spatial: the absolute values of the spatial components sorted in descending
+ * order, and the absolute value of the time component in its own slot. None: the
+ * tuple itself. Equivalent momenta share the representative, so it can key the
+ * orbit averages.
+ */
+inline MomentumTuple momentum_orbit(const MomentumTuple &p, const OrbitParams &orbits)
+{
+	if (orbits.symmetry == MomentumSymmetry::None)
+		return p;
+
+	MomentumTuple rep;
+	for (int mu = 0; mu < 4; ++mu)
+	{
+		rep[mu] = std::abs(p[mu]);
+	}
+	if (orbits.symmetry == MomentumSymmetry::Hypercubic)
+	{
+		std::sort(rep.begin(), rep.end(), std::greater<int>());
+		return rep;
+	}
+
+	std::vector<int> spatial;
+	for (int mu = 0; mu < 4; ++mu)
+	{
+		if (mu != orbits.timeDirection)
+			spatial.push_back(rep[mu]);
+	}
+	std::sort(spatial.begin(), spatial.end(), std::greater<int>());
+	for (int mu = 0, i = 0; mu < 4; ++mu)
+	{
+		if (mu != orbits.timeDirection)
+			rep[mu] = spatial[i++];
+	}
+	return rep;
+}
+
+/**
+ * @brief Cylinder and cone cuts around the diagonal, applied to an orbit representative.
+ *
+ * @details The diagonal is (1,1,1,1), or (1,1,1) in the spatial components for the
+ * Spatial symmetry. Cuts are evaluated on the representative (non-negative components),
+ * so a whole orbit is either kept or dropped: each of its momenta lies as close to one
+ * of the equivalent diagonals as the representative does to (1,1,1,1).
+ */
+inline bool passes_momentum_cuts(const MomentumTuple &orbit, const OrbitParams &orbits)
+{
+	if (orbits.cylinderRadius < 0.0 && orbits.coneAngle < 0.0)
+		return true;
+
+	double norm2 = 0.0, along = 0.0;
+	int dims = 0;
+	for (int mu = 0; mu < 4; ++mu)
+	{
+		if (orbits.symmetry == MomentumSymmetry::Spatial && mu == orbits.timeDirection)
+			continue;
+		double n = std::abs(orbit[mu]);
+		norm2 += n * n;
+		along += n;
+		dims++;
+	}
+	along /= std::sqrt(static_cast<double>(dims)); // Projection on the unit diagonal
+
+	if (orbits.cylinderRadius >= 0.0 && norm2 - along * along > orbits.cylinderRadius * orbits.cylinderRadius + 1e-12)
+		return false;
+	if (orbits.coneAngle >= 0.0 && norm2 > 0.0 && along < std::cos(orbits.coneAngle * M_PI / 180.0) * std::sqrt(norm2) - 1e-12)
+		return false;
+	return true;
+}
+
+/**
+ * @brief Checks that the orbit parameters are usable on a lattice of the given extent.
+ *
+ * @details The time direction must be one of the four components. Orbits only average
+ * equivalent momenta if the permuted directions have the same extent: all four for the
+ * Hypercubic symmetry, the three spatial ones for the Spatial symmetry.
+ *
+ * @return True if the parameters are valid, otherwise prints the reason and returns false.
+ */
+bool check_orbit_params(const OrbitParams &orbits, const std::array<int, 4> &latticeExtent)
+{
+	if (orbits.timeDirection < 0 || orbits.timeDirection > 3)
+	{
+		std::cerr << "Error: time direction " << orbits.timeDirection << " is not a momentum component (0..3).\n";
+		return false;
+	}
+	const bool spatial = orbits.symmetry == MomentumSymmetry::Spatial;
+	const int reference = latticeExtent[spatial && orbits.timeDirection == 0 ? 1 : 0]; // Extent of a permuted direction
+	for (int mu = 0; mu < 4; ++mu)
+	{
+		bool permuted = orbits.symmetry == MomentumSymmetry::Hypercubic || (spatial && mu != orbits.timeDirection);
+		if (permuted && latticeExtent[mu] != reference)
+		{
+			std::cerr << "Error: " << symmetry_name(orbits.symmetry) << " momentum orbits need equal lattice extents in the permuted directions, got "
+								<< latticeExtent[0] << "x" << latticeExtent[1] << "x" << latticeExtent[2] << "x" << latticeExtent[3] << ".\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Parses a wildcard pattern of the form "LABEL p1 p2 p3 p4".
+ *
+ * @param[in] pattern Pattern string; each component is either an integer or '*'.
+ * @param[out] out Parsed pattern.
+ *
+ * @return True if the pattern has a label followed by exactly four components, each an integer or '*'.
+ */
+bool parse_momentum_pattern(const std::string &pattern, MomentumPattern &out)
+{
+	std::istringstream ss(pattern);
+	std::vector<std::string> parts;
+	std::string part;
+	while (ss >> part)
+	{
+		parts.push_back(part);
+	}
+	if (parts.size() != 5)
+	{
+		std::cerr << "Error: momentum pattern '" << pattern << "' must have a label and four components.\n";
+		return false;
+	}
+
+	out.pattern = pattern;
+	out.label = parts[0];
+	for (int mu = 0; mu < 4; ++mu)
+	{
+		const std::string &component = parts[mu + 1];
+		out.wildcard[mu] = (component == "*");
+		out.fixed[mu] = 0;
+		if (out.wildcard[mu])
+			continue;
+
+		// The whole component must be an integer: "1.5" or "x" would otherwise silently become 0
+		const char *first = component.data() + (component.size() > 1 && component[0] == '+'); // from_chars rejects a leading '+'
+		auto [end, ec] = std::from_chars(first, component.data() + component.size(), out.fixed[mu]);
+		if (ec != std::errc() || end != component.data() + component.size())
+		{
+			std::cerr << "Error: momentum component '" << component << "' of pattern '" << pattern << "' is neither an integer nor '*'.\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Splits a line into its label, momentum tuple and value.
+ *
+ * @param[in] first Pointer to the first character of the line.
+ * @param[in] last Pointer past the last character of the line.
+ * @param[out] label Label of the line (first token).
+ * @param[out] momentum The four integer components following the label.
+ * @param[out] value The value following the momentum.
+ *
+ * @return True if the line has the form "LABEL int int int int value".
+ */
+bool parse_momentum_line(const char *first, const char *last, std::string &label, MomentumTuple &momentum, double &value)
+{
+	while (first < last && std::isspace(static_cast<unsigned char>(*first)))
+		++first;
+	const char *labelEnd = first;
+	while (labelEnd < last && !std::isspace(static_cast<unsigned char>(*labelEnd)))
+		++labelEnd;
+	if (labelEnd == first || labelEnd == last)
+		return false;
+	label.assign(first, labelEnd);
+
+	// The line is terminated by '\n' or by the end of the buffer, both of which stop strtol/strtod
+	char *end = nullptr;
+	const char *pos = labelEnd;
+	for (int mu = 0; mu < 4; ++mu)
+	{
+		long n = std::strtol(pos, &end, 10);
+		if (end == pos || end > last)
+			return false;
+		momentum[mu] = static_cast<int>(n);
+		pos = end;
+	}
+	value = std::strtod(pos, &end);
+	return end != pos && end <= last;
+}
+
+/**
+ * @brief Extracts every momentum matching a set of wildcard patterns into dense tensors.
+ *
+ * @param[in] directoryPaths The directories containing the files to be processed.
+ * @param[in] fileType The extension of the files to be processed.
+ * @param[in] patterns Wildcard patterns such as "GP_T * * * *"; one tensor is returned per pattern.
+ * @param[in] ioParams Read-ahead parameters used while reading the files.
+ * @param[in] deduplicate If true, files duplicating the contents of another file are skipped.
+ * @param[in] orbits Symmetry orbits averaged while parsing, and momentum cuts.
+ *
+ * @return One MomentumTensor per pattern, rows sorted by configuration number and columns by momentum
+ * (by orbit representative when averaging over orbits).
+ *
+ * @details Every file is scanned once: the label of each line selects the candidate
+ * patterns and the integer momentum components are captured from the line itself, so
+ * the cost does not grow with the number of momenta. If a momentum appears more than
+ * once in a file only the first value is kept, with or without a symmetry. Entries
+ * missing from a file are NaN.
+ *
+ * With a symmetry, the distinct momenta of each file are folded into a (sum, count)
+ * pair per orbit once the file is parsed; the tensor holds the per-configuration orbit
+ * averages, and multiplicity holds the largest number of distinct momenta averaged into
+ * each orbit. Momenta failing the cuts are dropped as the line is parsed. The stored
+ * tensor, and every statistics pass over it, shrinks by the orbit size.
+ */
+std::vector<MomentumTensor> extract_momentum_tensors(const std::vector<std::string> &directoryPaths,
+																										 const std::string &fileType,
+																										 const std::vector<std::string> &patterns,
+																										 const ReadAheadParams &ioParams = {},
+																										 bool deduplicate = true,
+																										 const OrbitParams &orbits = {})
+{
+	std::vector<MomentumPattern> parsedPatterns;
+	std::multimap<std::string, size_t> patternsByLabel;
+	for (const auto &pattern : patterns)
+	{
+		MomentumPattern mp;
+		if (parse_momentum_pattern(pattern, mp))
+		{
+			patternsByLabel.emplace(mp.label, parsedPatterns.size());
+			parsedPatterns.push_back(mp);
+		}
+	}
+
+	// Sparse per-file results: (config, pattern) -> momentum (or orbit) -> (sum, count)
+	struct FileEntries
+	{
+		int config;
+		std::vector<std::map<MomentumTuple, std::pair<double, int>>> values;
+	};
+	std::vector<FileEntries> fileEntries;
+
+	std::vector<fs::path> files = list_data_files(directoryPaths, fileType, deduplicate);
+
+	read_ahead_files(files, ioParams, [&](FileBuffer &buf)
+									 {
+		if (!buf.ok)
+		{
+			std::cerr << "Error opening file: " << buf.path << std::endl;
+			return;
+		}
+
+		FileEntries entries{config_number_from_filename(buf.path), std::vector<std::map<MomentumTuple, std::pair<double, int>>>(parsedPatterns.size())};
+		std::vector<std::map<MomentumTuple, double>> firstValues(parsedPatterns.size());
+		bool hasValues = false;
+		std::string label;
+		MomentumTuple momentum;
+		double value;
+
+		const char *pos = buf.data.data();
+		const char *end = pos + buf.data.size();
+		while (pos < end)
+		{
+			const char *eol = std::find(pos, end, '\n');
+			if (parse_momentum_line(pos, eol, label, momentum, value))
+			{
+				auto range = patternsByLabel.equal_range(label);
+				for (auto it = range.first; it != range.second; ++it)
+				{
+					const MomentumPattern &mp = parsedPatterns[it->second];
+					bool matches = true;
+					for (int mu = 0; mu < 4; ++mu)
+					{
+						matches = matches && (mp.wildcard[mu] || mp.fixed[mu] == momentum[mu]);
+					}
+					if (!matches)
+						continue;
+
+					if (!passes_momentum_cuts(momentum_orbit(momentum, orbits), orbits))
+						continue;
+					firstValues[it->second].emplace(momentum, value); // Later duplicates of a momentum are ignored
+					hasValues = true;
+				}
+			}
+			pos = eol + 1;
+		}
+
+		// Fold the momenta of the file into their orbits
+		for (size_t p = 0; p < parsedPatterns.size(); ++p)
+		{
+			for (const auto &[momentum, first] : firstValues[p])
+			{
+				auto &[sum, count] = entries.values[p][momentum_orbit(momentum, orbits)];
+				sum += first;
+				count++;
+			}
+		}
+
+		if (hasValues)
+		{
+			fileEntries.push_back(std::move(entries));
+		}
+		else
+		{
+			std::cerr << "No values found for the specified patterns in file: " << buf.path << std::endl;
+		} });
+
+	std::sort(fileEntries.begin(), fileEntries.end(), [](const FileEntries &a, const FileEntries &b)
+						{ return a.config < b.config; });
+
+	std::vector<MomentumTensor> tensors(parsedPatterns.size());
+	for (size_t p = 0; p < parsedPatterns.size(); ++p)
+	{
+		MomentumTensor &tensor = tensors[p];
+		tensor.pattern = parsedPatterns[p].pattern;
+
+		for (const auto &entries : fileEntries)
+		{
+			tensor.configs.push_back(entries.config);
+			for (const auto &[momentum, _] : entries.values[p])
+			{
+				tensor.index.emplace(momentum, 0);
+			}
+		}
+
+		// Assign columns in ascending momentum order
+		for (auto &[momentum, column] : tensor.index)
+		{
+			column = tensor.momenta.size();
+			tensor.momenta.push_back(momentum);
+		}
+
+		const size_t numConfigs = tensor.configs.size();
+		tensor.values.assign(tensor.momenta.size() * numConfigs, std::numeric_limits<double>::quiet_NaN());
+		tensor.multiplicity.assign(tensor.momenta.size(), 0);
+		for (size_t c = 0; c < numConfigs; ++c)
+		{
+			for (const auto &[momentum, acc] : fileEntries[c].values[p])
+			{
+				size_t m = tensor.index[momentum];
+				tensor.values[m * numConfigs + c] = acc.first / acc.second;
+				tensor.multiplicity[m] = std::max(tensor.multiplicity[m], acc.second);
+			}
+		}
+	}
+	return tensors;
+}
+
+// Returns "0010" for single-digit components as in GP_T_0000, "12_-3_0_0" otherwise
+inline std::string momentum_to_string(const MomentumTuple &p)
+{
+	bool singleDigit = std::all_of(p.begin(), p.end(), [](int n)
+																 { return n >= 0 && n <= 9; });
+	std::string s;
+	for (int mu = 0; mu < 4; ++mu)
+	{
+		if (!singleDigit && mu > 0)
+			s += "_";
+		s += std::to_string(p[mu]);
+	}
+	return s;
+}
+
+// Lattice momentum squared sum_mu (2 sin(pi n_mu / L_mu))^2 of a momentum tuple on a lattice of extent L
+inline double lattice_momentum_squared(const MomentumTuple &p, const std::array<int, 4> &extent)
+{
+	double p2 = 0.0;
+	for (int mu = 0; mu < 4; ++mu)
+	{
+		double pHat = 2.0 * std::sin(M_PI * p[mu] / extent[mu]);
+		p2 += pHat * pHat;
+	}
+	return p2;
+}
+
+/**
+ * @brief Writes a momentum tensor to a file, one row per configuration and one column per momentum.
+ *
+ * @param[in] tensor The tensor to be written.
+ * @param[in] filename Name of the file to write the data to.
+ * @param[in] extraInfo Optional vector of strings representing extra information to be written before headers.
+ */
+void write_momentum_tensor_to_file(const MomentumTensor &tensor,
+																	 const std::string &filename,
+																	 const std::vector<std::string> &extraInfo = {})
+{
+	std::ofstream outfile(filename);
+	if (!outfile)
+	{
+		std::cerr << "Error opening file for writing: " << filename << std::endl;
+		return;
+	}
+
+	if (!extraInfo.empty())
+	{
+		for (const auto &info : extraInfo)
+		{
+			outfile << info << "\n";
+		}
+		outfile << std::endl;
+	}
+
+	std::string label = tensor.pattern.substr(0, tensor.pattern.find(' '));
+	outfile << "#config";
+	for (const auto &p : tensor.momenta)
+	{
+		outfile << "\t\t" << label << "_" << momentum_to_string(p);
+	}
+	outfile << std::endl;
+
+	for (size_t c = 0; c < tensor.num_configs(); ++c)
+	{
+		outfile << tensor.configs[c];
+		for (size_t m = 0; m < tensor.num_momenta(); ++m)
+		{
+			outfile << "\t\t" << tensor.at(c, m);
+		}
+		outfile << std::endl;
+	}
+	outfile.close();
+}
+
+/**
+ * @brief Writes a momentum tensor in the requested output format (configuration column, then one column per momentum).
+ *
+ * @param[in] tensor The tensor to be written.
+ * @param[in] basename Name of the file without extension; output_extension(format) is appended.
+ * @param[in] format Output format; binary formats write the momentum columns straight from the tensor storage.
+ * @param[in] extraInfo Optional vector of strings representing extra information to be written before headers.
+ * @param[out] layout Optional description of the written binary file.
+ */
+void write_momentum_tensor(const MomentumTensor &tensor,
+													 const std::string &basename,
+													 OutputFormat format,
+													 const std::vector<std::string> &extraInfo = {},
+													 BinaryLayout *layout = nullptr)
+{
+	if (format == OutputFormat::Text)
+	{
+		write_momentum_tensor_to_file(tensor, basename + output_extension(format), extraInfo);
+		return;
+	}
+
+	std::string label = tensor.pattern.substr(0, tensor.pattern.find(' '));
+	std::vector<double> configs(tensor.configs.begin(), tensor.configs.end());
+	std::vector<std::span<const double>> columns = {configs};
+	std::vector<std::string> names = {"config"};
+	for (size_t m = 0; m < tensor.num_momenta(); ++m)
+	{
+		columns.push_back(tensor.series_view(m));
+		names.push_back(label + "_" + momentum_to_string(tensor.momenta[m]));
+	}
+	write_binary_records(columns, names, basename + output_extension(format), format, extraInfo, layout);
+}
+
+#endif // momentum.hpp
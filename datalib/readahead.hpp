@@ -0,0 +1,267 @@
+#ifndef READAHEAD_HPP
+#define READAHEAD_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <filesystem>
+#include <sstream>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "filehandler.hpp"
+#include "dedup.hpp"
+
+namespace fs = std::filesystem;
+
+// ReadAheadParams struct to bound the amount of I/O kept in flight
+struct ReadAheadParams
+{
+	int numThreads = 4;														// Number of reader threads issuing pread calls
+	int maxFilesInFlight = 16;										// Maximum number of files read but not yet parsed
+	std::size_t maxBytesInFlight = 256UL << 20;		// Maximum number of bytes read but not yet parsed
+};
+
+// FileBuffer struct holding the whole contents of a file read ahead of the parser
+struct FileBuffer
+{
+	fs::path path;
+	std::string data;
+	bool ok = false;
+};
+
+/**
+ * @brief Reads a whole file into a buffer with positioned reads.
+ *
+ * @param[in] fd Open file descriptor of the file to be read.
+ * @param[in] fileSize Size of the file in bytes as reported by fstat.
+ * @param[out] buffer String receiving the file contents.
+ *
+ * @return True if the whole file was read, false otherwise.
+ */
+bool pread_whole_file(int fd, std::size_t fileSize, std::string &buffer)
+{
+	buffer.resize(fileSize);
+	std::size_t offset = 0;
+	while (offset < fileSize)
+	{
+		ssize_t n = ::pread(fd, &buffer[offset], fileSize - offset, static_cast<off_t>(offset));
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		if (n == 0)
+			break; // File was truncated while reading
+		offset += static_cast<std::size_t>(n);
+	}
+	buffer.resize(offset);
+	return true;
+}
+
+/**
+ * @brief Reads a list of files on a pool of reader threads and hands each filled buffer to a consumer.
+ *
+ * @param[in] files Paths of the files to be read.
+ * @param[in] params Number of reader threads and the file/byte budget kept in flight.
+ * @param[in] consumer Function called on the calling thread for every buffer, in completion order.
+ * @param[in] onRead Optional function called on the reader thread right after a buffer is filled, with the
+ * index of that thread (0 to numThreads - 1); calls from different readers run concurrently.
+ *
+ * @details Reader threads open the files, hint the kernel with posix_fadvise and
+ * fill the buffers with pread while the calling thread parses the buffers already
+ * completed, so that read latency overlaps with parsing. A reader only starts a new
+ * file when both the file and the byte budget allow it; a single file larger than
+ * maxBytesInFlight is still read once nothing else is in flight.
+ *
+ * With onRead the parsing itself can run on the readers, in parallel; whatever the
+ * buffer still holds when onRead returns is charged to the budget until the consumer
+ * has seen it.
+ */
+void read_ahead_files(const std::vector<fs::path> &files,
+											const ReadAheadParams &params,
+											const std::function<void(FileBuffer &)> &consumer,
+											const std::function<void(FileBuffer &, int)> &onRead = {})
+{
+	if (files.empty())
+		return;
+
+	std::mutex mtx;
+	std::condition_variable budgetFreed, bufferReady;
+	std::deque<FileBuffer> ready;
+	std::size_t filesInFlight = 0, bytesInFlight = 0;
+	std::atomic<std::size_t> nextFile{0};
+
+	auto reader = [&](int readerIndex)
+	{
+		for (std::size_t i = nextFile++; i < files.size(); i = nextFile++)
+		{
+			FileBuffer buf;
+			buf.path = files[i];
+
+			int fd = ::open(files[i].c_str(), O_RDONLY | O_CLOEXEC);
+			struct stat st{};
+			std::size_t fileSize = 0;
+			if (fd >= 0 && ::fstat(fd, &st) == 0)
+				fileSize = static_cast<std::size_t>(st.st_size);
+
+			// Wait for room in the in-flight budget
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				budgetFreed.wait(lock, [&]
+												 { return filesInFlight == 0 ||
+																	(filesInFlight < static_cast<std::size_t>(params.maxFilesInFlight) &&
+																	 bytesInFlight + fileSize <= params.maxBytesInFlight); });
+				filesInFlight++;
+				bytesInFlight += fileSize;
+			}
+
+			if (fd >= 0)
+			{
+				::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+				::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+				buf.ok = pread_whole_file(fd, fileSize, buf.data);
+				::close(fd);
+			}
+			if (!buf.ok)
+			{
+				buf.data.clear();
+				buf.data.shrink_to_fit();
+			}
+			if (onRead)
+				onRead(buf, readerIndex);
+
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				// Charge the budget with what is actually held
+				bytesInFlight = bytesInFlight - fileSize + buf.data.size();
+				ready.push_back(std::move(buf));
+			}
+			bufferReady.notify_one();
+		}
+	};
+
+	int numThreads = std::max(1, std::min<int>(params.numThreads, static_cast<int>(files.size())));
+	std::vector<std::thread> pool;
+	for (int t = 0; t < numThreads; ++t)
+	{
+		pool.emplace_back(reader, t);
+	}
+
+	// Parse buffers on the calling thread as soon as they are filled
+	for (std::size_t done = 0; done < files.size(); ++done)
+	{
+		FileBuffer buf;
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			bufferReady.wait(lock, [&]
+											 { return !ready.empty(); });
+			buf = std::move(ready.front());
+			ready.pop_front();
+		}
+
+		std::size_t heldBytes = buf.data.size();
+		consumer(buf);
+
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			filesInFlight--;
+			bytesInFlight -= heldBytes;
+		}
+		budgetFreed.notify_all();
+	}
+
+	for (auto &t : pool)
+	{
+		t.join();
+	}
+}
+
+/**
+ * @brief Read-ahead version of extract_pattern_values_from_file for an explicit list of files.
+ *
+ * @param files Paths of the files to be processed, e.g. from list_data_files.
+ * @param patterns The set of patterns to search for in the files.
+ * @param params Number of reader threads and the file/byte budget kept in flight.
+ * @param onFile Optional function called with the values of every file and the index of the reader
+ * thread that parsed it; calls from different readers run concurrently, so per-reader state needs no lock.
+ *
+ * @return A vector of MatchData structs, in the order the files finished parsing.
+ *
+ * @details Every file is parsed by the reader thread that read it, right after the
+ * read, and its buffer is released before the next file is started.
+ */
+std::vector<MatchData> extract_pattern_values_from_paths(const std::vector<fs::path> &files,
+																												 const std::vector<std::string> &patterns,
+																												 const ReadAheadParams &params = {},
+																												 const std::function<void(const MatchData &, int)> &onFile = {})
+{
+	std::vector<MatchData> gpDataList;
+	gpDataList.reserve(files.size());
+	std::mutex mtx;
+
+	read_ahead_files(files, params, [](FileBuffer &) {}, [&](FileBuffer &buf, int reader)
+									 {
+		if (!buf.ok)
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			std::cerr << "Error opening file: " << buf.path << std::endl;
+			return;
+		}
+
+		// Parsed in place: a stringstream would copy the buffer and double the memory held per file
+		MatchData fileData = extract_pattern_values_from_buffer(buf.data, buf.path.filename().string(), patterns);
+		buf.data.clear();
+		buf.data.shrink_to_fit();
+
+		// Store the file data if any values were found
+		if (match_data_has_values(fileData))
+		{
+			if (onFile)
+				onFile(fileData, reader);
+			std::lock_guard<std::mutex> lock(mtx);
+			gpDataList.push_back(std::move(fileData));
+		}
+		else
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			std::cerr << "No values found for the specified patterns in file: " << buf.path << std::endl;
+		} });
+
+	return gpDataList;
+}
+
+/**
+ * @brief Read-ahead version of extract_pattern_values_from_file.
+ *
+ * @param directoryPaths The directories containing the files to be processed.
+ * @param fileType The extension of the files to be processed.
+ * @param patterns The set of patterns to search for in the files.
+ * @param params Number of reader threads and the file/byte budget kept in flight.
+ * @param deduplicate If true, files duplicating the contents of another file (in any of the directories) are skipped before parsing.
+ * @param onFile Optional function called with the values of every file and the index of the reader thread that parsed it.
+ *
+ * @return A vector of MatchData structs, in the order the files finished parsing.
+ */
+std::vector<MatchData> extract_pattern_values_from_file_async(const std::vector<std::string> &directoryPaths,
+																															const std::string &fileType,
+																															const std::vector<std::string> &patterns,
+																															const ReadAheadParams &params = {},
+																															bool deduplicate = true,
+																															const std::function<void(const MatchData &, int)> &onFile = {})
+{
+	return extract_pattern_values_from_paths(list_data_files(directoryPaths, fileType, deduplicate), patterns, params, onFile);
+}
+
+#endif // readahead.hpp
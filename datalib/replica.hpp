@@ -0,0 +1,273 @@
+#ifndef REPLICA_HPP
+#define REPLICA_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <span>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+
+#include "stattools.hpp"
+
+/*
+ * Several independent Markov chains (replicas) of one ensemble. Concatenating them
+ * into one series would make bins, autocorrelation pairs and anything else that
+ * looks at neighbouring values straddle the seams between chains. Here each replica
+ * keeps its boundaries: bins and lag pairs never cross a seam, each replica is
+ * processed on its own thread, and the per-replica sums are combined at the end.
+ */
+
+// ReplicaSeries struct holding the replicas of one observable back to back, with their boundaries
+template <typename T>
+struct ReplicaSeries
+{
+    std::vector<T> values;                  // All replicas concatenated
+    std::vector<std::size_t> offsets = {0}; // Replica r is values[offsets[r], offsets[r+1])
+    std::vector<std::string> names;         // Name of each replica, e.g. its directory
+
+    void add_replica(const std::string &name, std::span<const T> data)
+    {
+        values.insert(values.end(), data.begin(), data.end());
+        offsets.push_back(values.size());
+        names.push_back(name);
+    }
+
+    std::size_t num_replicas() const { return offsets.size() - 1; }
+    std::size_t size() const { return values.size(); }
+    std::span<const T> replica(std::size_t r) const
+    {
+        return std::span<const T>(values.data() + offsets[r], offsets[r + 1] - offsets[r]);
+    }
+};
+
+// Runs fn(r) for every replica r on up to numThreads threads (0 for all hardware threads)
+template <typename Function>
+void for_each_replica(std::size_t numReplicas, int numThreads, const Function &fn)
+{
+    std::atomic<std::size_t> next{0};
+    auto worker = [&]()
+    {
+        for (std::size_t r = next++; r < numReplicas; r = next++)
+            fn(r);
+    };
+
+    if (numThreads <= 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    numThreads = std::max(1, std::min<int>(numThreads, static_cast<int>(numReplicas)));
+    std::vector<std::thread> pool;
+    for (int t = 0; t < numThreads; ++t)
+        pool.emplace_back(worker);
+    for (auto &t : pool)
+        t.join();
+}
+
+/**
+ * @brief Splits one chain file into replicas by configuration number.
+ *
+ * @param[in] name Name prefix of the replicas (a "/<first config>" suffix is added).
+ * @param[in] configs Configuration number of each value, in ascending order (column 0 of the sorted file).
+ * @param[in] values Values of the observable.
+ * @param[in] firstConfigs First configuration number of each replica, in ascending order.
+ * @param[in,out] replicas Replica set the (non-empty) replicas are appended to.
+ *
+ * @details Values before firstConfigs[0] are dropped. With an empty firstConfigs the
+ * whole file is one replica. Empty replicas (e.g. an unreadable file) are skipped.
+ */
+template <typename T>
+void split_replicas(const std::string &name,
+                    const std::vector<int> &configs,
+                    std::span<const T> values,
+                    const std::vector<int> &firstConfigs,
+                    ReplicaSeries<T> &replicas)
+{
+    if (firstConfigs.empty())
+    {
+        if (!values.empty())
+            replicas.add_replica(name, values);
+        return;
+    }
+
+    std::size_t i = 0;
+    while (i < values.size() && i < configs.size() && configs[i] < firstConfigs[0])
+        ++i;
+    for (std::size_t r = 0; r < firstConfigs.size(); ++r)
+    {
+        std::size_t begin = i;
+        while (i < values.size() && i < configs.size() && (r + 1 == firstConfigs.size() || configs[i] < firstConfigs[r + 1]))
+            ++i;
+        if (i > begin)
+            replicas.add_replica(name + "/" + std::to_string(firstConfigs[r]), values.subspan(begin, i - begin));
+    }
+}
+
+// Bins every replica separately with bin_data, so that no bin mixes two chains
+template <typename T>
+ReplicaSeries<T> replica_bin_data(const ReplicaSeries<T> &replicas, int bin_size)
+{
+    ReplicaSeries<T> binned;
+    for (std::size_t r = 0; r < replicas.num_replicas(); ++r)
+    {
+        std::vector<T> bins = bin_data(replicas.replica(r), bin_size);
+        binned.add_replica(replicas.names[r], bins);
+    }
+    return binned;
+}
+
+// ReplicaSummary struct: summarize_series of every replica and the combined estimate
+template <typename T>
+struct ReplicaSummary
+{
+    std::vector<SeriesSummary<T>> replicas;
+    SeriesSummary<T> combined;  // Statistics of all values; combined.binned concatenates the per-replica bins
+    ReplicaSeries<T> binned;    // Per-replica bins with their boundaries, for the autocorrelation
+    double replicaJackErr = 0.0; // Leave-one-replica-out jackknife error of the combined mean (0 with one replica)
+};
+
+/**
+ * @brief Summarizes every replica in parallel and combines the results.
+ *
+ * @param[in] replicas Replicas of one observable.
+ * @param[in] bin_size Bin size; bins are formed inside each replica.
+ * @param[in] numThreads Number of threads (0 for all hardware threads).
+ *
+ * @return Per-replica summaries and the combined summary.
+ *
+ * @details The combined mean is the mean of all values and the variance pools the
+ * within-replica variances with the spread of the replica means,
+ * N var = sum_r N_r (var_r + |m_r - m|^2), i.e. the spread of the values themselves.
+ * The binned mean and c_0 are pooled the same way over the bins of all replicas.
+ *
+ * The errors of the combined mean are built per replica instead of from the pooled
+ * deviations, so that they do not treat the chains as one series:
+ * - combined.jackErr leaves out one bin at a time, with bins formed inside each replica.
+ *   The i-th jackknife mean is (S - n_i b_i) / (N - n_i) for a bin of n_i values with
+ *   mean b_i, and sigma^2 = (B-1)/B sum_i |m_i - m|^2 over the B bins of all replicas.
+ * - replicaJackErr leaves out one whole replica at a time, which also captures
+ *   differences between the chains (e.g. incomplete thermalization).
+ */
+template <typename T>
+ReplicaSummary<T> summarize_replicas(const ReplicaSeries<T> &replicas, int bin_size, int numThreads = 0)
+{
+    ReplicaSummary<T> summary;
+    const std::size_t numReplicas = replicas.num_replicas();
+    summary.replicas.resize(numReplicas);
+    for_each_replica(numReplicas, numThreads, [&](std::size_t r)
+                     { summary.replicas[r] = summarize_series(replicas.replica(r), bin_size); });
+
+    SeriesSummary<T> &combined = summary.combined;
+    double numBins = 0.0;
+    for (const auto &s : summary.replicas)
+    {
+        combined.size += s.size;
+        combined.mean += s.mean * static_cast<double>(s.size);
+        combined.binnedMean += s.binnedMean * static_cast<double>(s.binned.size());
+        numBins += s.binned.size();
+    }
+    if (combined.size == 0)
+    {
+        std::cerr << "Error: no values in any replica.\n";
+        return summary;
+    }
+    combined.mean /= static_cast<double>(combined.size);
+    combined.binnedMean /= numBins;
+
+    double sumDevSq = 0.0, binSumDevSq = 0.0;
+    for (std::size_t r = 0; r < numReplicas; ++r)
+    {
+        const auto &s = summary.replicas[r];
+        sumDevSq += s.size * (s.variance + abs2(s.mean - combined.mean));
+        binSumDevSq += s.binned.size() * (s.c_0 + abs2(s.binnedMean - combined.binnedMean));
+        summary.binned.add_replica(replicas.names[r], s.binned);
+    }
+    const double n = combined.size;
+    combined.variance = sumDevSq / n;
+    combined.binned = summary.binned.values;
+    combined.c_0 = binSumDevSq / numBins;
+
+    // Jackknife over the bins of every replica; the last bin of a replica may hold fewer values
+    using A = accum_t<T>;
+    const A total = combined.mean * n;
+    double binJackSq = 0.0;
+    bin_size = std::max(bin_size, 1);
+    for (const auto &s : summary.replicas)
+    {
+        for (std::size_t b = 0; b < s.binned.size(); ++b)
+        {
+            const double count = std::min<double>(bin_size, static_cast<double>(s.size) - static_cast<double>(b) * bin_size);
+            if (count < n)
+                binJackSq += abs2((total - static_cast<A>(s.binned[b]) * count) / (n - count) - combined.mean);
+        }
+    }
+    combined.jackErr = numBins > 1 ? std::sqrt(binJackSq * (numBins - 1) / numBins) : 0.0;
+
+    // Jackknife over whole replicas
+    double replicaJackSq = 0.0;
+    for (const auto &s : summary.replicas)
+    {
+        const double count = static_cast<double>(s.size);
+        if (count < n)
+            replicaJackSq += abs2((total - s.mean * count) / (n - count) - combined.mean);
+    }
+    const double R = static_cast<double>(numReplicas);
+    summary.replicaJackErr = numReplicas > 1 ? std::sqrt(replicaJackSq * (R - 1) / R) : 0.0;
+
+    return summary;
+}
+
+/**
+ * @brief Replica-aware version of autoCorrel_sample_operator.
+ *
+ * @param[in] replicas Replicas of the (binned) observable.
+ * @param[out] vectorToStoreCorrCoefPair Vector of (tau, c_tau / c_0) pairs.
+ * @param[in] tau_max Maximum time displacement.
+ * @param[in] x_mean Mean of all values (e.g. the combined binnedMean).
+ * @param[in] c_0 Autocorrelation at tau = 0 around x_mean (e.g. the combined c_0).
+ * @param[in] numThreads Number of threads (0 for all hardware threads).
+ *
+ * @details c_tau = sum_r sum_{i < N_r - tau} (x_{r,i} - m)(x_{r,i+tau} - m) / sum_r (N_r - tau):
+ * pairs are only formed inside a replica, and every replica contributes in proportion
+ * to its number of pairs. Each replica's lag sums are accumulated on its own thread.
+ * With a single replica this matches autoCorrel_sample_operator for every tau < N.
+ */
+template <typename T>
+void replica_autoCorrel_sample_operator(const ReplicaSeries<T> &replicas,
+                                        std::vector<std::pair<int, double>> &vectorToStoreCorrCoefPair,
+                                        const int tau_max,
+                                        const double x_mean,
+                                        const double c_0,
+                                        int numThreads = 0)
+{
+    const std::size_t numReplicas = replicas.num_replicas();
+    std::vector<std::vector<double>> lagSums(numReplicas, std::vector<double>(std::max(tau_max, 0), 0.0));
+    std::vector<std::vector<double>> pairCounts(numReplicas, std::vector<double>(std::max(tau_max, 0), 0.0));
+
+    for_each_replica(numReplicas, numThreads, [&](std::size_t r)
+                     {
+        std::span<const T> x = replicas.replica(r);
+        for (int tau = 0; tau < tau_max && tau < static_cast<int>(x.size()); ++tau)
+        {
+            double sum = 0.0;
+            for (std::size_t i = 0; i + tau < x.size(); ++i)
+                sum += (x[i] - x_mean) * (x[i + tau] - x_mean);
+            lagSums[r][tau] = sum;
+            pairCounts[r][tau] = static_cast<double>(x.size() - tau);
+        } });
+
+    for (int tau = 0; tau < tau_max; ++tau)
+    {
+        double sum = 0.0, count = 0.0;
+        for (std::size_t r = 0; r < numReplicas; ++r)
+        {
+            sum += lagSums[r][tau];
+            count += pairCounts[r][tau];
+        }
+        if (count == 0.0)
+            break; // Longer than every replica
+        vectorToStoreCorrCoefPair.push_back(std::make_pair(tau, (sum / count) / c_0));
+    }
+}
+
+#endif // replica.hpp
@@ -0,0 +1,275 @@
+#ifndef RESULTCACHE_HPP
+#define RESULTCACHE_HPP
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <type_traits>
+#include <atomic>
+
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+// StageKey struct: 64-bit FNV-1a hash of everything a stage result depends on
+struct StageKey
+{
+	std::uint64_t value = 14695981039346656037ULL;
+
+	StageKey &add_bytes(const void *data, std::size_t size)
+	{
+		const unsigned char *bytes = static_cast<const unsigned char *>(data);
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			value ^= bytes[i];
+			value *= 1099511628211ULL;
+		}
+		return *this;
+	}
+
+	StageKey &add(const std::string &s)
+	{
+		std::uint64_t size = s.size(); // Length prefix keeps {"ab","c"} and {"a","bc"} apart
+		add_bytes(&size, sizeof(size));
+		return add_bytes(s.data(), s.size());
+	}
+
+	template <typename T>
+	StageKey &add(const T &x)
+	{
+		static_assert(std::is_arithmetic<T>::value, "StageKey::add expects a string or an arithmetic value");
+		return add_bytes(&x, sizeof(x));
+	}
+
+	StageKey &add(const std::vector<std::string> &v)
+	{
+		for (const auto &s : v)
+		{
+			add(s);
+		}
+		return add(v.size());
+	}
+
+	StageKey &add(const StageKey &upstream) { return add(upstream.value); }
+
+	std::string hex() const
+	{
+		char buf[17];
+		std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(value));
+		return buf;
+	}
+};
+
+/**
+ * @brief Key of the raw data in a directory: file names, sizes and modification times.
+ *
+ * @param[in] directoryPath The path to the directory containing the data files.
+ * @param[in] fileType The extension of the data files.
+ *
+ * @details Adding, removing or rewriting a configuration changes the key without
+ * reading the contents of the files.
+ */
+StageKey directory_key(const std::string &directoryPath, const std::string &fileType)
+{
+	std::map<std::string, std::pair<std::uintmax_t, long long>> listing; // Sorted: directory order is unspecified
+	for (const auto &entry : fs::directory_iterator(directoryPath))
+	{
+		if (entry.path().extension() == fileType)
+		{
+			listing[entry.path().filename().string()] = {entry.file_size(),
+																										static_cast<long long>(entry.last_write_time().time_since_epoch().count())};
+		}
+	}
+
+	StageKey key;
+	key.add(std::string("directory")).add(fs::absolute(directoryPath).string());
+	for (const auto &[name, stamp] : listing)
+	{
+		key.add(name).add(stamp.first).add(stamp.second);
+	}
+	return key;
+}
+
+// Key of a single file: path, size and modification time
+StageKey file_key(const std::string &filename)
+{
+	StageKey key;
+	key.add(std::string("file")).add(fs::absolute(filename).string());
+	std::error_code ec;
+	if (fs::exists(filename, ec))
+	{
+		key.add(static_cast<std::uintmax_t>(fs::file_size(filename, ec)));
+		key.add(static_cast<long long>(fs::last_write_time(filename, ec).time_since_epoch().count()));
+	}
+	return key;
+}
+
+// ResultCache struct storing stage outputs on local disk under the hash of their inputs
+struct ResultCache
+{
+	std::string directory;									 // Cache directory; an empty string disables the cache
+	std::map<std::string, int> hits, misses; // Per-stage counters for the report
+	mutable std::mutex countersMutex;				 // Stages may run concurrently (see taskgraph.hpp)
+
+	explicit ResultCache(const std::string &dir = "") : directory(dir)
+	{
+		if (!directory.empty())
+		{
+			std::error_code ec;
+			fs::create_directories(directory, ec);
+			if (ec)
+			{
+				std::cerr << "Result cache disabled, cannot create " << directory << ": " << ec.message() << std::endl;
+				directory.clear();
+			}
+		}
+	}
+
+	bool enabled() const { return !directory.empty(); }
+
+	void count(std::map<std::string, int> &counter, const std::string &stage)
+	{
+		std::lock_guard<std::mutex> lock(countersMutex);
+		counter[stage]++;
+	}
+
+	std::string entry_path(const std::string &stage, const StageKey &key) const
+	{
+		return (fs::path(directory) / (stage + "-" + key.hex() + ".bin")).string();
+	}
+
+	// Temporary name for writing an entry: unique per process and write, so concurrent stages never share one
+	static std::string temp_path(const std::string &path)
+	{
+		static std::atomic<unsigned long> counter{0};
+		return path + ".tmp." + std::to_string(::getpid()) + "." + std::to_string(counter++);
+	}
+
+	/**
+	 * @brief Returns the cached vector of a stage, computing and storing it on a miss.
+	 *
+	 * @param[in] stage Name of the stage (used in the file name and in the report).
+	 * @param[in] key Hash of the stage inputs and parameters.
+	 * @param[in] compute Function producing the stage output on a miss.
+	 */
+	template <typename T>
+	std::vector<T> vector_stage(const std::string &stage, const StageKey &key, const std::function<std::vector<T>()> &compute)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "cached values are stored as raw bytes");
+		StageKey typedKey = StageKey(key).add(sizeof(T));
+
+		if (enabled())
+		{
+			const std::string path = entry_path(stage, typedKey);
+			std::ifstream in(path, std::ios::binary);
+			std::uint64_t size = 0;
+			std::error_code ec;
+			const std::uintmax_t fileSize = fs::file_size(path, ec);
+			// The size header must match the file length, otherwise a corrupt entry could ask for any allocation
+			if (in && in.read(reinterpret_cast<char *>(&size), sizeof(size)) && !ec &&
+					(fileSize - sizeof(size)) % sizeof(T) == 0 && size == (fileSize - sizeof(size)) / sizeof(T))
+			{
+				std::vector<T> result(size);
+				if (in.read(reinterpret_cast<char *>(result.data()), size * sizeof(T)))
+				{
+					count(hits, stage);
+					return result;
+				}
+			}
+		}
+
+		count(misses, stage);
+		std::vector<T> result = compute();
+		if (enabled())
+		{
+			// Write to a temporary name first so that an interrupted run never leaves a truncated entry
+			std::string path = entry_path(stage, typedKey);
+			std::string tmpPath = temp_path(path);
+			std::ofstream out(tmpPath, std::ios::binary);
+			std::uint64_t size = result.size();
+			out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+			out.write(reinterpret_cast<const char *>(result.data()), size * sizeof(T));
+			out.close();
+			std::error_code ec;
+			if (out)
+				fs::rename(tmpPath, path, ec);
+			else
+				fs::remove(tmpPath, ec);
+		}
+		return result;
+	}
+
+	// Scalar version of vector_stage
+	double scalar_stage(const std::string &stage, const StageKey &key, const std::function<double()> &compute)
+	{
+		std::vector<double> result = vector_stage<double>(stage, key, [&]
+																											{ return std::vector<double>{compute()}; });
+		if (result.size() != 1)
+		{
+			std::cerr << "Ignoring cache entry of " << stage << " holding " << result.size() << " values instead of one" << std::endl;
+			return compute();
+		}
+		return result.front();
+	}
+
+	/**
+	 * @brief Restores a stage output file from the cache, or runs the stage and stores its output file.
+	 *
+	 * @param[in] stage Name of the stage.
+	 * @param[in] key Hash of the stage inputs and parameters.
+	 * @param[in] outputFile File written by the stage.
+	 * @param[in] compute Function running the stage and writing outputFile on a miss.
+	 */
+	void file_stage(const std::string &stage, const StageKey &key, const std::string &outputFile, const std::function<void()> &compute)
+	{
+		std::error_code ec;
+		if (enabled())
+		{
+			std::string path = entry_path(stage, key);
+			if (fs::exists(path, ec) && fs::copy_file(path, outputFile, fs::copy_options::overwrite_existing, ec))
+			{
+				count(hits, stage);
+				return;
+			}
+		}
+
+		count(misses, stage);
+		compute();
+		if (enabled())
+		{
+			std::string path = entry_path(stage, key);
+			std::string tmpPath = temp_path(path);
+			if (fs::copy_file(outputFile, tmpPath, fs::copy_options::overwrite_existing, ec))
+				fs::rename(tmpPath, path, ec);
+			else
+				fs::remove(tmpPath, ec);
+		}
+	}
+
+	// Prints the cache hits and misses of every stage
+	void print_report(std::ostream &os = std::cout) const
+	{
+		std::lock_guard<std::mutex> lock(countersMutex);
+		std::map<std::string, std::pair<int, int>> stages;
+		for (const auto &[stage, n] : hits)
+			stages[stage].first = n;
+		for (const auto &[stage, n] : misses)
+			stages[stage].second = n;
+
+		os << "# result cache (" << (enabled() ? directory : std::string("disabled")) << ")\n";
+		for (const auto &[stage, counts] : stages)
+		{
+			os << "#   " << stage << ": " << counts.first << " hit(s), " << counts.second << " miss(es)\n";
+		}
+		os << std::flush;
+	}
+};
+
+#endif // resultcache.hpp
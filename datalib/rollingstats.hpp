@@ -0,0 +1,184 @@
+#ifndef ROLLINGSTATS_HPP
+#define ROLLINGSTATS_HPP
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+// Windowed mean, variance and binned error over the last `window` values of a Monte Carlo chain
+struct RollingStats
+{
+  /**
+   * Every push is O(1), whatever the window and bin sizes.
+   *
+   * The binned error uses the non-overlapping bins of size bin_size that end at the
+   * current step. The sliding bin mean B_t = mean(x_{t-b+1..t}) is kept for each step,
+   * and the bins ending at t, t-b, t-2b, ... all share the residue t mod b, so one
+   * pair of running sums per residue is enough to update the error in O(1).
+   * Values are shifted by the first value of the chain to avoid cancellation.
+   *
+   * @param window Number of configurations in the window (rounded up to a multiple of bin_size).
+   * @param bin_size Bin size used for the binned error.
+   */
+  explicit RollingStats(int window, int bin_size = 1)
+      : bin_size(std::max(bin_size, 1)),
+        window(((std::max(window, 1) + this->bin_size - 1) / this->bin_size) * this->bin_size),
+        values(this->window, 0.0), binMeans(this->window, 0.0),
+        binSum(this->bin_size, 0.0), binSumSq(this->bin_size, 0.0) {}
+
+  void push(double x)
+  {
+    if (n == 0)
+      shift = x;
+    double y = x - shift;
+    long long slot = n % window;
+
+    // Sliding sums over the window
+    if (n >= window)
+    {
+      double old = values[slot];
+      sum -= old;
+      sumSq -= old * old;
+    }
+    sum += y;
+    sumSq += y * y;
+
+    // Sliding bin of the last bin_size values
+    binRun += y;
+    if (n >= bin_size)
+      binRun -= values[(n - bin_size) % window];
+    values[slot] = y;
+
+    // Bin ending at n enters its residue class, bin ending at n - window leaves it
+    int residue = n % bin_size;
+    if (n >= window)
+    {
+      double old = binMeans[slot];
+      binSum[residue] -= old;
+      binSumSq[residue] -= old * old;
+    }
+    double b = (n + 1 >= bin_size) ? binRun / bin_size : 0.0;
+    binMeans[slot] = b;
+    if (n + 1 >= bin_size)
+    {
+      binSum[residue] += b;
+      binSumSq[residue] += b * b;
+    }
+    n++;
+  }
+
+  long long size() const { return n; }
+  int window_size() const { return window; }
+  bool full() const { return n >= window; }
+
+  // Number of values currently in the window
+  long long count() const { return std::min<long long>(n, window); }
+
+  double mean() const { return shift + sum / count(); }
+
+  // Population variance E[X^2] - E[X]^2 as in variance() of stattools.hpp
+  double variance() const
+  {
+    double m = sum / count();
+    return std::max(sumSq / count() - m * m, 0.0);
+  }
+
+  // Standard error of the mean from the non-overlapping bins ending at the current step
+  double binned_error() const
+  {
+    int residue = (n - 1) % bin_size;
+    long long nBins = count() / bin_size; // Full bins ending at n-1, n-1-bin_size, ... inside the window
+    if (nBins < 2)
+      return std::numeric_limits<double>::quiet_NaN();
+    double m = binSum[residue] / nBins;
+    double var = std::max(binSumSq[residue] / nBins - m * m, 0.0);
+    return std::sqrt(var / (nBins - 1));
+  }
+
+private:
+  int bin_size, window;
+  std::vector<double> values;     // Last `window` shifted values
+  std::vector<double> binMeans;   // Last `window` sliding bin means
+  std::vector<double> binSum;     // Sum of the bin means in the window, per residue
+  std::vector<double> binSumSq;   // Sum of the squared bin means in the window, per residue
+  double shift = 0.0, sum = 0.0, sumSq = 0.0, binRun = 0.0;
+  long long n = 0;
+};
+
+
+/**
+ * @brief Computes rolling statistics for several window sizes in one pass and writes them as a time series.
+ *
+ * @param[in] data Monte Carlo chain of an observable.
+ * @param[in] windows Window sizes; one (mean, variance, binned error) triple of columns is written per window.
+ * @param[in] bin_size Bin size used for the binned error.
+ * @param[in] filename Name of the file to write the time series to.
+ * @param[in] stride Only every stride-th configuration is written (the statistics are still updated at every step).
+ * @param[in] extraInfo Optional vector of strings representing extra information to be written before headers.
+ *
+ * @details Rows before a window is full are computed on the values seen so far.
+ * The output can be plotted directly, e.g. "plot file using 1:2" for the mean of the first window.
+ */
+template <typename T>
+void rolling_stats_operator(const std::vector<T> &data,
+                            const std::vector<int> &windows,
+                            int bin_size,
+                            const std::string &filename,
+                            int stride = 1,
+                            const std::vector<std::string> &extraInfo = {})
+{
+  std::ofstream outfile(filename);
+  if (!outfile)
+  {
+    std::cerr << "Error opening file for writing: " << filename << std::endl;
+    return;
+  }
+
+  std::vector<RollingStats> stats;
+  for (int w : windows)
+  {
+    stats.emplace_back(w, bin_size);
+  }
+
+  if (!extraInfo.empty())
+  {
+    for (const auto &info : extraInfo)
+    {
+      outfile << info << "\n";
+    }
+    outfile << std::endl;
+  }
+
+  outfile << "#config";
+  for (const auto &s : stats)
+  {
+    outfile << "\t\tmean_" << s.window_size() << "\t\tvariance_" << s.window_size() << "\t\tbinErr_" << s.window_size();
+  }
+  outfile << std::endl;
+
+  stride = std::max(stride, 1);
+  for (size_t t = 0; t < data.size(); ++t)
+  {
+    for (auto &s : stats)
+    {
+      s.push(data[t]);
+    }
+
+    if ((t + 1) % stride == 0 || t + 1 == data.size())
+    {
+      outfile << t;
+      for (const auto &s : stats)
+      {
+        outfile << "\t\t" << s.mean() << "\t\t" << s.variance() << "\t\t" << s.binned_error();
+      }
+      outfile << "\n";
+    }
+  }
+  outfile.close();
+}
+
+#endif // rollingstats.hpp
@@ -0,0 +1,356 @@
+#ifndef SKETCHES_HPP
+#define SKETCHES_HPP
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <functional>
+
+// Cluster of nearby values summarized by their mean and count
+struct Centroid
+{
+    double mean;
+    double weight;
+};
+
+// Mergeable t-digest quantile sketch (merging variant, Dunning & Ertl)
+struct TDigest
+{
+    /**
+     * Memory is O(compression) whatever the number of values. Centroids are
+     * small near the tails (q -> 0, 1) and large near the median, so extreme
+     * quantiles are the most accurate. Values are buffered and merged in
+     * batches, which keeps add() O(1) amortized.
+     *
+     * @param compression Accuracy parameter delta: the number of centroids grows with delta, not with the data.
+     */
+    explicit TDigest(double compression = 100.0)
+        : compression(compression) { buffer.reserve(bufferSize()); }
+
+    void add(double x, double w = 1.0)
+    {
+        if (std::isnan(x))
+            return;
+        buffer.push_back({x, w});
+        minValue = std::min(minValue, x);
+        maxValue = std::max(maxValue, x);
+        if (buffer.size() >= bufferSize())
+            compress();
+    }
+
+    // Adds every centroid of another digest, e.g. the sketch of another thread
+    void merge(const TDigest &other)
+    {
+        for (const auto &c : other.centroids)
+            buffer.push_back(c);
+        for (const auto &c : other.buffer)
+            buffer.push_back(c);
+        minValue = std::min(minValue, other.minValue);
+        maxValue = std::max(maxValue, other.maxValue);
+        compress();
+    }
+
+    double count() const
+    {
+        double n = 0.0;
+        for (const auto &c : centroids)
+            n += c.weight;
+        for (const auto &c : buffer)
+            n += c.weight;
+        return n;
+    }
+
+    double min() const { return minValue; }
+    double max() const { return maxValue; }
+
+    // Returns the estimated q-quantile (0 <= q <= 1) by interpolating between centroids
+    double quantile(double q)
+    {
+        compress();
+        if (centroids.empty())
+            return std::numeric_limits<double>::quiet_NaN();
+        if (centroids.size() == 1 || q <= 0.0)
+            return q <= 0.0 ? minValue : centroids[0].mean;
+        if (q >= 1.0)
+            return maxValue;
+
+        const double target = q * totalWeight;
+        // Each centroid's mean sits at the middle of its weight
+        double cumulative = centroids[0].weight / 2.0;
+        if (target < cumulative)
+            return minValue + (centroids[0].mean - minValue) * target / cumulative;
+
+        for (size_t i = 1; i < centroids.size(); ++i)
+        {
+            double step = (centroids[i - 1].weight + centroids[i].weight) / 2.0;
+            if (target < cumulative + step)
+            {
+                double t = (target - cumulative) / step;
+                return centroids[i - 1].mean + t * (centroids[i].mean - centroids[i - 1].mean);
+            }
+            cumulative += step;
+        }
+
+        double last = centroids.back().weight / 2.0;
+        return centroids.back().mean + (maxValue - centroids.back().mean) * std::min((target - cumulative) / last, 1.0);
+    }
+
+    // Merges the buffered values into the centroids
+    void compress()
+    {
+        if (buffer.empty())
+            return;
+
+        for (const auto &c : centroids)
+            buffer.push_back(c);
+        std::sort(buffer.begin(), buffer.end(), [](const Centroid &a, const Centroid &b)
+                  { return a.mean < b.mean; });
+
+        totalWeight = 0.0;
+        for (const auto &c : buffer)
+            totalWeight += c.weight;
+
+        // Size bound 4 N q (1 - q) / delta of the k1 scale function
+        auto maxWeight = [&](double q)
+        { return 4.0 * totalWeight * q * (1.0 - q) / compression; };
+
+        centroids.clear();
+        Centroid current = buffer[0];
+        double weightSoFar = 0.0;
+        for (size_t i = 1; i < buffer.size(); ++i)
+        {
+            double proposed = current.weight + buffer[i].weight;
+            double q0 = weightSoFar / totalWeight;
+            double q2 = (weightSoFar + proposed) / totalWeight;
+            if (proposed <= std::max(1.0, std::min(maxWeight(q0), maxWeight(q2))))
+            {
+                current.mean += (buffer[i].mean - current.mean) * buffer[i].weight / proposed;
+                current.weight = proposed;
+            }
+            else
+            {
+                weightSoFar += current.weight;
+                centroids.push_back(current);
+                current = buffer[i];
+            }
+        }
+        centroids.push_back(current);
+        buffer.clear();
+    }
+
+    double compression;
+    std::vector<Centroid> centroids;
+
+private:
+    size_t bufferSize() const { return static_cast<size_t>(5 * compression) + 16; }
+
+    std::vector<Centroid> buffer;
+    double totalWeight = 0.0;
+    double minValue = std::numeric_limits<double>::infinity();
+    double maxValue = -std::numeric_limits<double>::infinity();
+};
+
+
+// Mergeable histogram with fixed, equally spaced bins over [lo, hi)
+struct Histogram
+{
+    Histogram(double lo, double hi, int numBins)
+        : lo(lo), hi(hi), counts(std::max(numBins, 1), 0) {}
+
+    void add(double x)
+    {
+        if (std::isnan(x))
+            return;
+        if (x < lo)
+            underflow++;
+        else if (x >= hi)
+            overflow++;
+        else
+            counts[std::min<size_t>(static_cast<size_t>((x - lo) / (hi - lo) * counts.size()), counts.size() - 1)]++;
+    }
+
+    // Adds the counts of a histogram with the same binning
+    bool merge(const Histogram &other)
+    {
+        if (other.lo != lo || other.hi != hi || other.counts.size() != counts.size())
+        {
+            std::cerr << "Error: cannot merge histograms with different binning.\n";
+            return false;
+        }
+        for (size_t i = 0; i < counts.size(); ++i)
+            counts[i] += other.counts[i];
+        underflow += other.underflow;
+        overflow += other.overflow;
+        return true;
+    }
+
+    double bin_center(size_t i) const { return lo + (i + 0.5) * (hi - lo) / counts.size(); }
+
+    double lo, hi;
+    std::vector<long long> counts;
+    long long underflow = 0, overflow = 0;
+};
+
+
+// Binning of the histograms and accuracy of the quantile sketches
+struct SketchParams
+{
+    double histLow = 0.0;       // Lower histogram edge
+    double histHigh = 0.0;      // Upper histogram edge (histLow >= histHigh: the range of the data, see fill_histograms)
+    int numBins = 100;          // Number of histogram bins
+    double compression = 100.0; // Compression of the t-digests
+};
+
+// Distribution sketches of one observable
+struct ObservableSketch
+{
+    TDigest digest;
+    Histogram histogram; // Only filled once it has a range (lo < hi)
+
+    void add(double x)
+    {
+        digest.add(x);
+        if (histogram.lo < histogram.hi)
+            histogram.add(x);
+    }
+
+    // Adds the sketch of the same observable filled by another thread
+    void merge(const ObservableSketch &other)
+    {
+        digest.merge(other.digest);
+        if (histogram.lo < histogram.hi)
+            histogram.merge(other.histogram);
+    }
+};
+
+/**
+ * @brief Empty sketches of numSeries observables, to be filled one value at a time.
+ *
+ * @details Memory is O(compression + numBins) per observable whatever the size of the
+ * ensemble. Without a histogram range in params only the digests are filled; the
+ * histograms are set up afterwards by fill_histograms.
+ */
+std::vector<ObservableSketch> make_sketches(size_t numSeries, const SketchParams &params)
+{
+    const bool ranged = params.histLow < params.histHigh;
+    return std::vector<ObservableSketch>(numSeries, ObservableSketch{TDigest(params.compression),
+                                                                     Histogram(ranged ? params.histLow : 0.0, ranged ? params.histHigh : 0.0, params.numBins)});
+}
+
+// Merges the sketches filled by several threads (one vector per thread) into the first one
+std::vector<ObservableSketch> merge_sketches(std::vector<std::vector<ObservableSketch>> &&perThread)
+{
+    if (perThread.empty())
+        return {};
+    std::vector<ObservableSketch> merged = std::move(perThread[0]);
+    for (size_t t = 1; t < perThread.size(); ++t)
+    {
+        for (size_t s = 0; s < merged.size() && s < perThread[t].size(); ++s)
+            merged[s].merge(perThread[t][s]);
+    }
+    return merged;
+}
+
+/**
+ * @brief Fills the histograms of sketches that were filled without a histogram range.
+ *
+ * @param[in,out] sketches Sketches whose digests hold every value.
+ * @param[in] forEachValue Callable forEachValue(s, consumer) passing every value of series s to consumer(double) once more.
+ * @param[in] numBins Number of histogram bins.
+ * @param[in] edge Optional map applied to the digest's min and max, e.g. the rounding of the values forEachValue replays.
+ *
+ * @details The range of each histogram is the range of its digest, which a sketch knows
+ * exactly, so one more pass over the values fills the histograms. Sketches that already
+ * have a histogram range are left untouched.
+ */
+template <typename ForEachValue>
+void fill_histograms(std::vector<ObservableSketch> &sketches, ForEachValue &&forEachValue, int numBins,
+                     const std::function<double(double)> &edge = {})
+{
+    for (size_t s = 0; s < sketches.size(); ++s)
+    {
+        if (sketches[s].histogram.lo < sketches[s].histogram.hi)
+            continue;
+
+        double lo = sketches[s].digest.min(), hi = sketches[s].digest.max();
+        if (!(lo <= hi))
+            lo = hi = 0.0;
+        else if (edge)
+        {
+            lo = edge(lo);
+            hi = edge(hi);
+        }
+        // The upper edge is exclusive: move it just past the largest value
+        hi = (hi > lo) ? std::nextafter(hi, std::numeric_limits<double>::infinity()) : lo + 1.0;
+
+        Histogram &histogram = sketches[s].histogram = Histogram(lo, hi, numBins);
+        forEachValue(s, [&histogram](double x)
+                     { histogram.add(x); });
+    }
+}
+
+
+/**
+ * @brief Writes a histogram as (bin center, count) lines with optional extra information.
+ *
+ * @param[in] histogram Histogram to be written.
+ * @param[in] filename Name of the file to write the data to.
+ * @param[in] extraInfo Optional vector of strings representing extra information to be written before headers.
+ */
+void write_histogram_to_file(const Histogram &histogram,
+                             const std::string &filename,
+                             const std::vector<std::string> &extraInfo = {})
+{
+    std::ofstream outfile(filename);
+    if (!outfile)
+    {
+        std::cerr << "Error opening file for writing: " << filename << std::endl;
+        return;
+    }
+
+    for (const auto &info : extraInfo)
+        outfile << info << "\n";
+    outfile << "# underflow: " << histogram.underflow << "\n"
+            << "# overflow: " << histogram.overflow << "\n"
+            << std::endl;
+
+    outfile << "#bin_center\t\tcount" << std::endl;
+    for (size_t i = 0; i < histogram.counts.size(); ++i)
+        outfile << histogram.bin_center(i) << "\t\t" << histogram.counts[i] << std::endl;
+}
+
+
+/**
+ * @brief Flags the configurations whose value lies outside the [qLow, qHigh] quantile range.
+ *
+ * @param[in] digest Sketch of the distribution of the observable.
+ * @param[in] configs Configuration number of each value.
+ * @param[in] values Values of the observable, one per configuration.
+ * @param[in] qLow Lower quantile (e.g. 0.001).
+ * @param[in] qHigh Upper quantile (e.g. 0.999).
+ *
+ * @return (configuration, value) pairs of the flagged configurations.
+ */
+template <typename T>
+std::vector<std::pair<int, double>> flag_outliers(TDigest &digest,
+                                                  const std::vector<int> &configs,
+                                                  const std::vector<T> &values,
+                                                  double qLow, double qHigh)
+{
+    const double lowCut = digest.quantile(qLow);
+    const double highCut = digest.quantile(qHigh);
+
+    std::vector<std::pair<int, double>> outliers;
+    for (size_t i = 0; i < values.size() && i < configs.size(); ++i)
+    {
+        if (values[i] < lowCut || values[i] > highCut)
+            outliers.push_back(std::make_pair(configs[i], static_cast<double>(values[i])));
+    }
+    return outliers;
+}
+
+#endif // sketches.hpp
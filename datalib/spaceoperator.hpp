@@ -2,13 +2,89 @@
 #define SPACEOPERATOR_HPP
 
 #include "filehandler.hpp"
+#include "readahead.hpp"
+#include "labelindex.hpp"
 #include "stattools.hpp"
+#include "sketches.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <thread>
+#include <atomic>
+
+// Autocorrelation coefficients c_tau / c_0 for tau < coefficients.size(), written into a caller-provided buffer
+// (complex coefficients for a complex series)
+template <typename Series>
+void autoCorrel_coefficients(const Series &dataToCreateCorrSample,
+                             std::span<accum_t<element_t<Series>>> coefficients,
+                             const accum_t<element_t<Series>> x_mean,
+                             const double c_0)
+{
+  for (std::size_t tau = 0; tau < coefficients.size(); ++tau)
+  {
+    coefficients[tau] = auto_correl(dataToCreateCorrSample, static_cast<int>(tau), x_mean) / c_0;
+  }
+}
+
+
+// Parallel version of autoCorrel_coefficients: each tau is summed sequentially by one thread, so any thread count gives the same bits
+template <typename Series>
+void autoCorrel_coefficients(const Series &dataToCreateCorrSample,
+                             std::span<accum_t<element_t<Series>>> coefficients,
+                             const accum_t<element_t<Series>> x_mean,
+                             const double c_0,
+                             const ReduceParams &rp)
+{
+  std::atomic<std::size_t> nextTau{0};
+  auto worker = [&]()
+  {
+    for (std::size_t tau = nextTau++; tau < coefficients.size(); tau = nextTau++)
+      coefficients[tau] = auto_correl(dataToCreateCorrSample, static_cast<int>(tau), x_mean) / c_0;
+  };
+
+  int numThreads = std::min<int>(std::max(rp.numThreads, 1), static_cast<int>(coefficients.size()));
+  if (numThreads <= 1)
+  {
+    worker();
+    return;
+  }
+  std::vector<std::thread> pool;
+  for (int t = 0; t < numThreads; ++t)
+    pool.emplace_back(worker);
+  for (auto &t : pool)
+    t.join();
+}
+
+
+// Autocorrelation coefficients with the mean and c_0 already known, e.g. from summarize_series
+template <typename Series>
+void autoCorrel_sample_operator(const Series &dataToCreateCorrSample,
+                                std::vector<std::pair<int, accum_t<element_t<Series>>>>& vectorToStoreCorrCoefPair,
+                                const int tau_max,
+                                const accum_t<element_t<Series>> x_mean,
+                                const double c_0)
+{
+  accum_t<element_t<Series>> corr_coef = 0.0;
+  
+  // Write autocorrelation results for each tau
+  for (int tau = 0; tau < tau_max; ++tau)
+  {
+    // Calculate autocorrelation.
+    accum_t<element_t<Series>> c_tau = auto_correl(dataToCreateCorrSample, tau, x_mean);
+    corr_coef = c_tau / c_0;
+
+    // Store tau and autocorrelation coefficient in vector.
+    vectorToStoreCorrCoefPair.push_back(std::make_pair(tau, corr_coef));
+  }
+}
+
 
 /**
  * @brief Calculate autocorrelation for a given input vector up to a specified maximum tau (time displacement).
  *
- * @param[in] dataToCreateCorrSample Vector of double values to calculate autocorrelation.
- * @param[out] corr_coef_pair Vector of pairs to store the autocorrelation coefficient for each tau.
+ * @param[in] dataToCreateCorrSample Series (vector, span or strided view) to calculate autocorrelation.
+ * @param[out] corr_coef_pair Vector of pairs to store the autocorrelation coefficient for each tau
+ * (complex coefficients for a complex series).
  * @param[in] tau_max Maximum time displacement for autocorrelation calculation.
  *
  * @details The function calculates the autocorrelation coefficient for each tau
@@ -17,37 +93,102 @@
  * coefficient is calculated as c_tau / c_0, where c_0 is the autocorrelation
  * at tau = 0 and c_tau is the autocorrelation at tau.
  */
-void autoCorrel_sample_operator(const std::vector<double> &dataToCreateCorrSample,
-                                std::vector<std::pair<int, double>>& vectorToStoreCorrCoefPair,
+template <typename Series>
+void autoCorrel_sample_operator(const Series &dataToCreateCorrSample,
+                                std::vector<std::pair<int, accum_t<element_t<Series>>>>& vectorToStoreCorrCoefPair,
                                 const int tau_max) 
 {
-  double c_0 = auto_correl(dataToCreateCorrSample, 0);
-  double corr_coef = 0;
-  
-  // Write autocorrelation results for each tau
-  for (int tau = 0; tau < tau_max; ++tau)
-  {
-    // Calculate autocorrelation.
-    double c_tau = auto_correl(dataToCreateCorrSample, tau);
-    corr_coef = c_tau / c_0;
+  // The mean does not depend on tau: compute it once; c_0 = E|x - mean|^2 is real
+  const accum_t<element_t<Series>> x_mean = mean(dataToCreateCorrSample);
+  autoCorrel_sample_operator(dataToCreateCorrSample, vectorToStoreCorrCoefPair, tau_max,
+                             x_mean, std::real(auto_correl(dataToCreateCorrSample, 0, x_mean)));
+}
 
-    // Store tau and autocorrelation coefficient in vector.
-    vectorToStoreCorrCoefPair.push_back(std::make_pair(tau, corr_coef));
+
+/**
+ * @brief Madras-Sokal error bars of the autocorrelation coefficients of autoCorrel_sample_operator.
+ *
+ * @param[in] corrCoefPair Vector of (tau, c_tau / c_0) pairs for tau = 0, 1, 2, ...
+ * @param[in] n Length of the series the coefficients were computed from.
+ * @param[out] errors Error of every coefficient.
+ * @param[out] tauInt Optional integrated autocorrelation time within the automatic window.
+ * @param[out] windowClosed Optional flag, false if the coefficients end before the window condition is met
+ * (W is then the last lag and tauInt a lower bound).
+ *
+ * @return The automatic window W.
+ */
+std::size_t autoCorrel_error_operator(const std::vector<std::pair<int, double>> &corrCoefPair,
+                                      std::size_t n,
+                                      std::vector<double> &errors,
+                                      double *tauInt = nullptr,
+                                      bool *windowClosed = nullptr)
+{
+  std::vector<double> rho(corrCoefPair.size());
+  for (size_t i = 0; i < corrCoefPair.size(); ++i)
+  {
+    rho[i] = corrCoefPair[i].second;
   }
+  errors.assign(rho.size(), 0.0);
+  std::size_t W = autocorr_errors(rho, n, errors, 6.0, windowClosed);
+  if (tauInt)
+    *tauInt = integrated_autocorr_time(rho, W);
+  return W;
+}
+
+
+/**
+ * @brief Out-of-core version of autoCorrel_sample_operator reading the series from a column file.
+ *
+ * @param[in] filename Text file (column columnIndex) or binary column file (columnIndex < 0) holding the series.
+ * @param[in] columnIndex Column to read from a text file, or a negative value for a binary column file.
+ * @param[out] vectorToStoreCorrCoefPair Vector of pairs to store the autocorrelation coefficient for each tau.
+ * @param[in] tau_max Maximum time displacement for autocorrelation calculation.
+ *
+ * @details The series is never held in memory: only O(tau_max) values are kept,
+ * and the coefficients are normalized by c_0 exactly as in the in-memory path.
+ */
+void autoCorrel_stream_operator(const std::string &filename,
+                                const int columnIndex,
+                                std::vector<std::pair<int, double>>& vectorToStoreCorrCoefPair,
+                                const int tau_max)
+{
+  StreamingAutoCorrel acc(tau_max);
+  auto push = [&acc](double x) { acc.push(x); };
+
+  long long count = (columnIndex < 0) ? stream_binary_column(filename, push)
+                                      : stream_column(filename, columnIndex, push);
+  if (count <= 0)
+    return;
+
+  acc.coefficients(vectorToStoreCorrCoefPair);
 }
 
 
 void specialGen_sort_trunc_file_operator(const std::vector<std::string>& patterns,
                                     const std::string &outputFilename,
-                                    const std::string &dataPath,
+                                    const std::vector<std::string> &dataPaths,
                                     const std::string &fileExtension,
-                                    const std::string &outputDirectory)
+                                    const std::string &outputDirectory,
+                                    const ReadAheadParams &ioParams = {},
+                                    const std::string &labelIndexFile = "",
+                                    bool deduplicate = true,
+                                    const std::function<void(const MatchData &, int)> &onFile = {})
 {
-  // Collect and store data from files
-  std::vector<MatchData> dataExtracted = extract_pattern_values_from_file(dataPath, fileExtension, patterns);
+  // Collect and store data from files (reads are overlapped with parsing),
+  // or read only the indexed label lines when an index file is given.
+  // Files duplicating another configuration, in any of the directories, are skipped so they are not counted twice.
+  // Further consumers of the parsed values (e.g. distribution sketches) get every file through onFile as it is parsed,
+  // together with the index of the reader thread parsing it.
+  std::vector<MatchData> dataExtracted = labelIndexFile.empty()
+                                             ? extract_pattern_values_from_file_async(dataPaths, fileExtension, patterns, ioParams, deduplicate, onFile)
+                                             : extract_pattern_values_indexed(dataPaths, fileExtension, patterns, labelIndexFile, ioParams, deduplicate, onFile);
 
-  // Write data that mathches patterns into file
-  write_match_data_to_file(dataExtracted, outputDirectory + "tempFile1.dat", {"#file_name", "values extracted"});
+  // Temporary files are named after the output so that several ingests can run at the same time
+  const std::string tempFile1 = outputDirectory + "tempFile1_" + outputFilename;
+  const std::string tempFile2 = outputDirectory + "tempFile2_" + outputFilename;
+
+  // Write data that mathches patterns into file: column 0 is the file, then one column per pattern, in the order of patterns
+  write_match_data_to_file(dataExtracted, tempFile1, {"#file_name", "values extracted"}, patterns);
 
   // Print Output results -- for debug purposes
   if (false)
@@ -68,33 +209,212 @@ void specialGen_sort_trunc_file_operator(const std::vector<std::string>& pattern
   }
 
   // Post-Process function to get configuration from data-file name
-  extract_config_of_file(outputDirectory + "tempFile1.dat", outputDirectory + "tempFile2.dat");
+  extract_config_of_file(tempFile1, tempFile2);
 
   // Remove the preocessed (previous) file
-  //remove_file(outputDirectory + "tempFile1.dat");
+  //remove_file(tempFile1);
   
   // Sort the column colSort of a file
   const int colToSort = 0;
-  sort_column_in_file(outputDirectory + "tempFile2.dat", outputDirectory + outputFilename, colToSort);
+  sort_column_in_file(tempFile2, outputDirectory + outputFilename, colToSort);
   
   // Remove the preocessed (previous) file
-  //remove_file(outputDirectory + "tempFile2.dat");
+  //remove_file(tempFile2);
 }
 
 // Function to generate N bootstrap averages and store in averages (vector)
-void gen_bootstrap_averages(const std::vector<double>& data, int N, std::vector<double>& averages) 
+template <typename Series>
+void gen_bootstrap_averages(const Series& data, int N, std::vector<accum_t<element_t<Series>>>& averages) 
 {
   averages.clear();  // Clear any existing contents in the averages vector
   averages.reserve(N);
 
+  // One generator and one sample buffer reused for every resample
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::vector<element_t<Series>> bootstrapSample(data.size());
+
   for (int i = 0; i < N; ++i) 
   {
-    std::vector<double> bootstrapSample = bootstrap_generate_sample(data);
-    double average = mean(bootstrapSample);
+    bootstrap_generate_sample(data, std::span<element_t<Series>>(bootstrapSample), gen);
+    accum_t<element_t<Series>> average = mean(bootstrapSample);
     averages.push_back(average);
   }
 }
 
 
+/**
+ * @brief Measures the accuracy loss and speed-up of storing a series as float instead of double.
+ *
+ * @param[in] data Series stored in double precision (reference).
+ * @param[in] bin_size Bin size used before the autocorrelation.
+ * @param[in] tau_max Maximum time displacement for the autocorrelation.
+ * @param[in] label Name of the observable printed in the report.
+ *
+ * @details Every statistic accumulates in double for both storage types, so the
+ * differences reported come only from rounding the raw values to float.
+ */
+void print_precision_loss(const std::vector<double> &data, int bin_size, int tau_max, const std::string &label)
+{
+  std::vector<float> dataFloat(data.begin(), data.end());
+
+  auto relDiff = [](double ref, double val) { return ref != 0.0 ? std::abs(val - ref) / std::abs(ref) : std::abs(val); };
+  auto timeIt = [](auto &&f)
+  {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  };
+
+  double meanD = 0, meanF = 0, varD = 0, varF = 0, errD = 0, errF = 0;
+  std::vector<std::pair<int, double>> corrD, corrF;
+  double tD = timeIt([&] { meanD = mean(data); varD = variance(data); errD = jack_error(data);
+                           autoCorrel_sample_operator(bin_data(data, bin_size), corrD, tau_max); });
+  double tF = timeIt([&] { meanF = mean(dataFloat); varF = variance(dataFloat); errF = jack_error(dataFloat);
+                           autoCorrel_sample_operator(bin_data(dataFloat, bin_size), corrF, tau_max); });
+
+  double maxCorrDiff = 0.0;
+  for (size_t i = 0; i < corrD.size() && i < corrF.size(); ++i)
+  {
+    maxCorrDiff = std::max(maxCorrDiff, std::abs(corrD[i].second - corrF[i].second));
+  }
+
+  std::cout << "# precision loss (float storage): " << label << "\n"
+            << "#   mean rel. diff:          " << relDiff(meanD, meanF) << "\n"
+            << "#   variance rel. diff:      " << relDiff(varD, varF) << "\n"
+            << "#   jackknife err rel. diff: " << relDiff(errD, errF) << "\n"
+            << "#   max |corr_coef diff|:    " << maxCorrDiff << "\n"
+            << "#   footprint: " << data.size() * sizeof(double) << " -> " << dataFloat.size() * sizeof(float) << " bytes\n"
+            << "#   time: " << tD << " ms (double) vs " << tF << " ms (float)" << std::endl;
+}
+
+/**
+ * @brief Prints the cost of reproducible reductions against the fast ones.
+ *
+ * @param[in] data Raw values of one observable.
+ * @param[in] bin_size Bin size for the binned statistics.
+ * @param[in] tau_max Maximum time displacement for the autocorrelation.
+ * @param[in] label Name of the observable printed in the report.
+ *
+ * @details Times summarize_series and the autocorrelation coefficients in both
+ * reduction modes on 1, 2, 4 and 8 threads, and checks that the reproducible
+ * results are bitwise equal for every thread count. The largest deviation of the
+ * fast results from the one-thread result shows how much the rounding moves.
+ */
+void print_reduction_overhead(const std::vector<double> &data, int bin_size, int tau_max, const std::string &label)
+{
+  auto timeIt = [](auto &&f)
+  {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  };
+  auto sameBits = [](const SeriesSummary<double> &a, const SeriesSummary<double> &b)
+  {
+    return a.mean == b.mean && a.variance == b.variance && a.jackErr == b.jackErr &&
+           a.binnedMean == b.binnedMean && a.c_0 == b.c_0 && a.binned == b.binned;
+  };
+
+  // Built first and printed at once, so that reports of concurrent stages do not interleave
+  std::ostringstream report;
+  report << "# reduction overhead: " << label << " (" << data.size() << " values)\n"
+            << "#   threads   fast (ms)   reproducible (ms)   fast |mean diff|\n";
+  SeriesSummary<double> reference;
+  bool reproducible = true;
+  for (int numThreads : {1, 2, 4, 8})
+  {
+    SeriesSummary<double> fast, repro;
+    ReduceParams fastParams{numThreads, Reduction::Fast}, reproParams{numThreads, Reduction::Reproducible};
+    auto run = [&](SeriesSummary<double> &summary, const ReduceParams &rp)
+    {
+      summary = summarize_series(data, bin_size, rp);
+      std::vector<double> coefs(std::min<std::size_t>(std::max(tau_max, 0), summary.binned.size()));
+      autoCorrel_coefficients(summary.binned, std::span<double>(coefs), summary.binnedMean, summary.c_0, rp);
+    };
+    double tFast = timeIt([&] { run(fast, fastParams); });
+    double tRepro = timeIt([&] { run(repro, reproParams); });
+    if (numThreads == 1)
+      reference = repro;
+    reproducible = reproducible && sameBits(reference, repro);
+
+    report << "#   " << std::setw(7) << numThreads << std::setw(12) << tFast << std::setw(20) << tRepro
+              << std::setw(19) << std::abs(fast.mean - reference.mean) << "\n";
+  }
+  report << "#   reproducible results bitwise equal across thread counts: " << (reproducible ? "yes" : "no") << "\n";
+  std::cout << report.str() << std::flush;
+}
+
+/**
+ * @brief Adds the values of one parsed file to the sketch of each pattern.
+ *
+ * @param[in] fileData The values of one file, e.g. as passed to the onFile hook of specialGen_sort_trunc_file_operator.
+ * @param[in] patterns The patterns to be sketched, in the order of the sketches.
+ * @param[in,out] sketches One sketch per pattern, owned by the thread parsing the file.
+ */
+void sketch_match_data(const MatchData &fileData,
+                       const std::vector<std::string> &patterns,
+                       std::vector<ObservableSketch> &sketches)
+{
+  for (size_t p = 0; p < patterns.size() && p < sketches.size(); ++p)
+  {
+    auto it = fileData.values.find(patterns[p]);
+    if (it == fileData.values.end())
+      continue;
+    for (double value : it->second)
+    {
+      sketches[p].add(value);
+    }
+  }
+}
+
+// Value of x as written to the sorted file (default stream precision) and read back
+inline double as_written(double x)
+{
+  std::ostringstream text;
+  text << x;
+  return std::stod(text.str());
+}
+
+/**
+ * @brief Fills the histograms the ingest left without a range from the columns of the sorted file.
+ *
+ * @param[in,out] sketches Sketches with complete digests, one per column.
+ * @param[in] filename Path to the sorted file, read one value at a time.
+ * @param[in] columns Column index of each series (0-based).
+ * @param[in] numBins Number of histogram bins.
+ *
+ * @details The range is the exact range of each digest, rounded as the sorted file
+ * rounds the values, so no value falls outside it.
+ */
+void fill_histograms_from_columns(std::vector<ObservableSketch> &sketches,
+                                  const std::string &filename,
+                                  const std::vector<int> &columns,
+                                  int numBins)
+{
+  fill_histograms(sketches, [&](size_t c, auto &&consumer)
+                  { stream_column(filename, columns[c], consumer); }, numBins, as_written);
+}
+
+/**
+ * @brief Sketches the distribution of columns of a text file, e.g. the sorted file of a cached ingest.
+ *
+ * @param[in] filename Path to the file, read one value at a time.
+ * @param[in] columns Column index of each series (0-based); one sketch is returned per column.
+ * @param[in] params Histogram binning (range taken from the data if not given) and t-digest compression.
+ */
+std::vector<ObservableSketch> sketch_columns(const std::string &filename,
+                                             const std::vector<int> &columns,
+                                             const SketchParams &params = {})
+{
+  std::vector<ObservableSketch> sketches = make_sketches(columns.size(), params);
+  for (size_t c = 0; c < columns.size(); ++c)
+  {
+    stream_column(filename, columns[c], [&sketch = sketches[c]](double x)
+                  { sketch.add(x); });
+  }
+  fill_histograms_from_columns(sketches, filename, columns, params.numBins);
+  return sketches;
+}
+
 
 #endif // SPACEOPERATOR_HPP
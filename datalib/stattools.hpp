@@ -3,27 +3,95 @@
 
 #include <iostream>
 #include <vector>
+#include <span>
+#include <complex>
+#include <type_traits>
 #include <numeric> // for std::accumulate
 #include <cmath>   // for std::pow
 #include <algorithm>
 #include <random>
-
-// Returns the mean value of values in a vector
-double mean(const std::vector<double> &x)
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+/*
+ * Every kernel below takes its input as a generic "series": any type with size() and
+ * operator[], e.g. std::vector, std::span (columns, mmapped data, subranges) or
+ * StridedView (every k-th element, one column of a row-major array). Nothing is
+ * copied; outputs go to caller-provided std::span buffers, with std::vector
+ * returning versions kept for convenience. Element types are float, double or
+ * std::complex<double>; sums are always accumulated in double precision.
+ */
+
+// Non-owning view of count elements spaced by stride
+template <typename T>
+struct StridedView
+{
+    T *ptr;
+    std::size_t count;
+    std::ptrdiff_t stride = 1;
+
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T &operator[](std::size_t i) const { return ptr[static_cast<std::ptrdiff_t>(i) * stride]; }
+};
+
+// Element type of a series
+template <typename Series>
+using element_t = std::remove_cv_t<std::remove_reference_t<decltype(std::declval<const Series &>()[0])>>;
+
+// Accumulation type of an element type: double for real values, std::complex<double> for complex values
+template <typename T>
+struct accumulator { using type = double; };
+template <typename T>
+struct accumulator<std::complex<T>> { using type = std::complex<double>; };
+template <typename T>
+using accum_t = typename accumulator<T>::type;
+
+// |x|^2 and complex conjugate that reduce to x*x and x for real values
+inline double abs2(double x) { return x * x; }
+inline double abs2(const std::complex<double> &z) { return std::norm(z); }
+inline double conj_if_complex(double x) { return x; }
+inline std::complex<double> conj_if_complex(const std::complex<double> &z) { return std::conj(z); }
+
+// Returns the mean value of values in a series
+template <typename Series>
+accum_t<element_t<Series>> mean(const Series &x)
 {
   
-  double mean = 0.0;
-  for (int i = 0; i < x.size(); i++)
+  accum_t<element_t<Series>> mean = 0.0;
+  for (std::size_t i = 0; i < x.size(); i++)
   {
-     mean += x[i];
+     mean += static_cast<accum_t<element_t<Series>>>(x[i]);
   }
-    mean /= x.size();
+    mean /= static_cast<double>(x.size());
     return mean;
  }
 
 
+// Calculate the autocorrelation for a given correl. dist. tau around a precomputed mean
+template <typename Series>
+accum_t<element_t<Series>> auto_correl(const Series& x, int tau, accum_t<element_t<Series>> x_mean)
+{
+    using A = accum_t<element_t<Series>>;
+    A c_tau = 0.;
+    int div_2 = 0.;
+
+    // Calculate the correlation
+    for (int i = 0; i + tau < static_cast<int>(x.size()); i++)
+    {
+        c_tau += conj_if_complex(static_cast<A>(x[i]) - x_mean) * (static_cast<A>(x[i + tau]) - x_mean);
+        div_2++;
+    }
+    c_tau /= static_cast<double>(div_2);
+
+    return c_tau;
+}
+
+
 // Calculate the autocorrelation for a given correl. dist. tau
-double auto_correl(const std::vector<double>& x, int tau)
+template <typename Series>
+accum_t<element_t<Series>> auto_correl(const Series& x, int tau)
 {
     /**
      * Calculate the autocorrelation function for a given time series.
@@ -34,146 +102,714 @@ double auto_correl(const std::vector<double>& x, int tau)
      * @return The autocorrelation at the given time displacement.
      */
 
-    double x_mean = 0., c_tau = 0.;
-    int div_1 = 0., div_2 = 0.;
+    return auto_correl(x, tau, mean(x));
+}
+
+
+// Accumulates autocorrelations up to tau_max of a series fed one value at a time
+struct StreamingAutoCorrel
+{
+    /**
+     * Streaming version of auto_correl: memory use is O(tau_max) independently
+     * of the length of the series.
+     *
+     * Every pushed value is shifted by the first value of the series, which leaves the
+     * centered correlation unchanged but avoids cancellation when the mean is large
+     * compared to the fluctuations. The lag products sum_i y_i y_{i+tau} are accumulated
+     * together with the first and last tau_max values, which is all that is needed to
+     * center the products with the global mean once the series is complete.
+     */
+    explicit StreamingAutoCorrel(int tau_max)
+        : tau_max(std::max(tau_max, 1)), lagSum(this->tau_max, 0.0), head(), ring(this->tau_max, 0.0) {}
 
-    for (int i = 0; i < x.size(); i++)
+    void push(double x)
     {
-        x_mean += x[i];
-        div_1++;
+        if (n == 0)
+            shift = x;
+        double y = x - shift;
+
+        ring[n % tau_max] = y;
+        if (head.size() < static_cast<std::size_t>(tau_max))
+            head.push_back(y);
+
+        // y_{n - tau} lives in the ring for every tau < tau_max
+        long long maxTau = std::min<long long>(tau_max - 1, n);
+        for (long long tau = 0; tau <= maxTau; ++tau)
+        {
+            lagSum[tau] += y * ring[(n - tau) % tau_max];
+        }
+        sum += y;
+        n++;
     }
-    x_mean /= div_1;
 
-    // Calculate the correlation
-    for (int i = 0; i < x.size() - tau; i++)
+    long long size() const { return n; }
+
+    // Returns the autocorrelation at tau, identical to auto_correl on the full series
+    double c_tau(int tau) const
     {
-        c_tau += (x[i] - x_mean) * (x[i + tau] - x_mean);
-        div_2++;
+        double sumHead = 0.0, sumTail = 0.0;
+        for (int i = 0; i < tau; ++i)
+        {
+            sumHead += head[i];
+            sumTail += ring[(n - 1 - i) % tau_max];
+        }
+        return centered(tau, sumHead, sumTail);
     }
-    c_tau /= div_2;
 
-    return c_tau;
-}
+    // Stores (tau, c_tau / c_0) for every tau < min(tau_max, N) as autoCorrel_sample_operator does
+    void coefficients(std::vector<std::pair<int, double>> &vectorToStoreCorrCoefPair) const
+    {
+        long long maxTau = std::min<long long>(tau_max, n);
+        double c_0 = centered(0, 0.0, 0.0);
+        double sumHead = 0.0, sumTail = 0.0;
+        for (int tau = 0; tau < maxTau; ++tau)
+        {
+            vectorToStoreCorrCoefPair.push_back(std::make_pair(tau, centered(tau, sumHead, sumTail) / c_0));
+            sumHead += head[tau];
+            sumTail += ring[(n - 1 - tau) % tau_max];
+        }
+    }
+
+private:
+    // (1/(N-tau)) sum_{i<N-tau} (y_i - m)(y_{i+tau} - m), with sumHead/sumTail the sums of the first/last tau values
+    double centered(int tau, double sumHead, double sumTail) const
+    {
+        double m = sum / n;
+        double count = static_cast<double>(n - tau);
+        double sumFirst = sum - sumTail; // sum_{i < N - tau} y_i
+        double sumLast = sum - sumHead;  // sum_{i >= tau} y_i
+        return (lagSum[tau] - m * (sumFirst + sumLast) + count * m * m) / count;
+    }
+
+    int tau_max;
+    std::vector<double> lagSum;  // sum_i y_i y_{i+tau}
+    std::vector<double> head;    // First tau_max shifted values
+    std::vector<double> ring;    // Last tau_max shifted values
+    double shift = 0.0, sum = 0.0;
+    long long n = 0;
+};
 
 
-// Compute variance from a vector with data
-double variance(const std::vector<double>& data)
+// Compute variance from a series with data
+template <typename Series>
+double variance(const Series& data)
 {
-    if (data.empty()) {
+    if (data.size() == 0) {
         std::cerr << "Error: Data vector is empty.\n";
         return 0.0;
     }
 
     // Calculate the mean (E[X])
-    double meanVal = mean(data);
+    auto meanVal = mean(data);
 
-    // Calculate the mean of squared values (E[X^2])
+    // Calculate the mean of squared values (E[|X|^2])
     double meanOfSquares = 0.0;
-    for (const double& value : data) {
-        meanOfSquares += std::pow(value, 2);
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        meanOfSquares += abs2(static_cast<accum_t<element_t<Series>>>(data[i]));
     }
     meanOfSquares /= data.size();
 
-    // Variance using the formula Var[X] = E[X^2] - (E[X])^2
-    double variance = meanOfSquares - std::pow(meanVal, 2);
+    // Variance using the formula Var[X] = E[|X|^2] - |E[X]|^2
+    double variance = meanOfSquares - abs2(meanVal);
 
     return variance;
 }
 
 
 // Compute the jack_sample-th jackknife sample
-// from input vector data into output vector jack_data
-void jack_set(const std::vector<double> &data, std::vector<double> &jack_data, int jack_sample)
+// from input series data into the caller-provided buffer jack_data (size N-1)
+template <typename Series, typename T>
+void jack_set(const Series &data, std::span<T> jack_data, int jack_sample)
 {
 
-    if (jack_sample < 0 || jack_sample >= data.size())
+    if (jack_sample < 0 || jack_sample >= static_cast<int>(data.size()))
     {
         std::cerr << "jack_sample=" << jack_sample << " outside allowable range [0, " << data.size() - 1 << "]" << std::endl;
         exit(1);
     }
 
-    jack_data.resize(0);
-    for (int i = 0; i < data.size(); i++)
+    std::size_t j = 0;
+    for (std::size_t i = 0; i < data.size() && j < jack_data.size(); i++)
     {
-        if (i != jack_sample)
+        if (static_cast<int>(i) != jack_sample)
         {
-            jack_data.push_back(data[i]);
+            jack_data[j++] = data[i];
         }
     }
 }
 
+// Same as above into an output vector jack_data
+template <typename Series, typename T>
+void jack_set(const Series &data, std::vector<T> &jack_data, int jack_sample)
+{
+    jack_data.resize(data.size() > 0 ? data.size() - 1 : 0);
+    jack_set(data, std::span<T>(jack_data), jack_sample);
+}
+
+
+// Jackknife sample means: jack_means[i] is the mean of data without element i, i.e. (S - x_i) / (N - 1)
+template <typename Series, typename T>
+void jack_means(const Series &data, std::span<T> jack_means)
+{
+    using A = accum_t<element_t<Series>>;
+    const std::size_t n = data.size();
+    if (n < 2)
+    {
+        std::cerr << "Error: at least 2 values are needed for jackknife means.\n";
+        return;
+    }
+    A total = mean(data) * static_cast<double>(n);
+    for (std::size_t i = 0; i < n && i < jack_means.size(); i++)
+    {
+        jack_means[i] = static_cast<T>((total - static_cast<A>(data[i])) / static_cast<double>(n - 1));
+    }
+}
+
 
 // Compute the jackknife error
-double jack_error(const std::vector<double> &data)
+template <typename Series>
+double jack_error(const Series &data)
 {
-    double m = mean(data); // Get original mean
-    double sumsq = 0;            // Use this for variance: Sum ( jackMean - m)^2
+    /**
+     * The i-th jackknife mean is (S - x_i) / (N - 1) with S the total sum,
+     * so no jackknife sample has to be built: O(N) instead of O(N^2).
+     */
+    using A = accum_t<element_t<Series>>;
+    const std::size_t n = data.size();
+    A m = mean(data);               // Get original mean
+    A total = m * static_cast<double>(n);
+    double sumsq = 0;               // Use this for variance: Sum |jackMean - m|^2
 
     // Compute mean on each jackknife sample
-    for (int i = 0; i < data.size(); i++)
+    for (std::size_t i = 0; i < n; i++)
     {
-        std::vector<double> jack_sample;
-
-        jack_set(data, jack_sample, i);       // Get i-th jackknife sample
-        double jackMean = mean(jack_sample); // Compute ith jackknife mean
-        sumsq += (jackMean - m) * (jackMean - m);  // accumulate variance term
+        A jackMean = (total - static_cast<A>(data[i])) / static_cast<double>(n - 1); // ith jackknife mean
+        sumsq += abs2(jackMean - m);  // accumulate variance term
     }
 
     // Normalize variance
-    sumsq *= (double)(data.size() - 1) / (double)data.size();
+    sumsq *= (double)(n - 1) / (double)n;
     return std::sqrt(sumsq); // return square root of variance ie error
 }
 
 
-// Function to calculate averages of bin-sized parts of data
-std::vector<double> bin_data(const std::vector<double>& data, int bin_size)
+// Function to calculate averages of bin-sized parts of data into the caller-provided
+// buffer bin_averages (at least ceil(N / bin_size) elements); returns the number of bins
+template <typename Series, typename T>
+std::size_t bin_data(const Series& data, int bin_size, std::span<T> bin_averages)
+{
+    using A = accum_t<element_t<Series>>;
+    std::size_t data_size = data.size();
+    std::size_t index = 0;  // Track the index in the data
+    std::size_t nBins = 0;
+
+    // Loop through the data and process full bins, then the remainder for the last bin
+    while (index < data_size && nBins < bin_averages.size()) {
+        std::size_t end = std::min(index + static_cast<std::size_t>(bin_size), data_size);
+        A sum = 0.0;
+        for (std::size_t i = index; i < end; ++i)
+            sum += static_cast<A>(data[i]);
+        A average = sum / static_cast<double>(end - index);
+        bin_averages[nBins++] = static_cast<T>(average);
+        index = end;
+    }
+
+    return nBins;
+}
+
+// Same as above returning a new vector
+template <typename Series>
+std::vector<element_t<Series>> bin_data(const Series& data, int bin_size)
 {
-    std::vector<double> bin_averages;  // Vector to store the averages
-    int data_size = data.size();
-    int index = 0;  // Track the index in the data
+    bin_size = std::max(bin_size, 1);
+    std::vector<element_t<Series>> bin_averages((data.size() + bin_size - 1) / bin_size);
+    bin_averages.resize(bin_data(data, bin_size, std::span<element_t<Series>>(bin_averages)));
+    return bin_averages;
+}
 
-    // Loop through the data and process full bins
-    while (index + bin_size <= data_size) {
-        double sum = std::accumulate(data.begin() + index, data.begin() + index + bin_size, 0.0);
-        double average = sum / bin_size;
-        bin_averages.push_back(average);
-        index += bin_size;
+// SeriesSummary struct holding every statistic of one observable computed by summarize_series
+template <typename T>
+struct SeriesSummary
+{
+    std::size_t size = 0;
+    accum_t<T> mean = 0.0;        // Same as mean(data)
+    double variance = 0.0;        // Same as variance(data)
+    double jackErr = 0.0;         // Same as jack_error(data)
+    std::vector<T> binned;        // Same as bin_data(data, bin_size)
+    accum_t<T> binnedMean = 0.0;  // Mean of the binned series
+    double c_0 = 0.0;             // Same as auto_correl(binned, 0), normalization of the autocorrelation
+};
+
+// Compute mean, variance, jackknife error, binned series and lag-0 autocorrelation in one sweep
+template <typename Series>
+SeriesSummary<element_t<Series>> summarize_series(const Series& data, int bin_size)
+{
+    /**
+     * Fused version of mean, variance, jack_error, bin_data and auto_correl(., 0):
+     * the data is read once instead of once per statistic (and N+1 times for the
+     * jackknife).
+     *
+     * The jackknife error of the mean has the closed form
+     * sqrt( sum_i |x_i - m|^2 / (N (N-1)) ), since the i-th jackknife mean is
+     * m + (m - x_i) / (N-1). All sums are taken on values shifted by data[0],
+     * which avoids cancellation when the mean is large compared to the fluctuations.
+     */
+    using T = element_t<Series>;
+    using A = accum_t<T>;
+    SeriesSummary<T> summary;
+    const std::size_t n = data.size();
+    summary.size = n;
+    if (n == 0) {
+        std::cerr << "Error: Data vector is empty.\n";
+        return summary;
     }
+    bin_size = std::max(bin_size, 1);
+    summary.binned.reserve((n + bin_size - 1) / bin_size);
+
+    const A shift = static_cast<A>(data[0]);
+    A sum = 0.0, binSum = 0.0;                  // Shifted raw / binned values
+    double sumSq = 0.0, binSumSq = 0.0;
+    A binAcc = 0.0;
+    int inBin = 0;
+
+    auto close_bin = [&](int count) {
+        T b = static_cast<T>(binAcc / static_cast<double>(count));
+        summary.binned.push_back(b);
+        A y = static_cast<A>(b) - shift;
+        binSum += y;
+        binSumSq += abs2(y);
+        binAcc = 0.0;
+        inBin = 0;
+    };
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        A y = static_cast<A>(data[i]) - shift;
+        sum += y;
+        sumSq += abs2(y);
 
-    // Handle any remaining elements (remainder) for the last bin
-    if (index < data_size) {
-        double sum = std::accumulate(data.begin() + index, data.end(), 0.0);
-        double average = sum / (data_size - index);  // Average of remaining elements
-        bin_averages.push_back(average);
+        binAcc += static_cast<A>(data[i]);
+        if (++inBin == bin_size)
+            close_bin(bin_size);
     }
+    if (inBin > 0)
+        close_bin(inBin); // Remainder bin, as in bin_data
 
-    return bin_averages;
+    A m = sum / static_cast<double>(n);
+    double sumDevSq = std::max(sumSq - n * abs2(m), 0.0); // sum_i |x_i - mean|^2
+
+    summary.mean = shift + m;
+    summary.variance = sumDevSq / n;
+    summary.jackErr = n > 1 ? std::sqrt(sumDevSq / (double(n) * double(n - 1))) : 0.0;
+
+    const double nb = summary.binned.size();
+    A mb = binSum / nb;
+    summary.binnedMean = shift + mb;
+    summary.c_0 = std::max(binSumSq / nb - abs2(mb), 0.0);
 
+    return summary;
+}
+
+
+// In-place radix-2 FFT of a buffer whose size is a power of two (the inverse omits the 1/n factor)
+void fft(std::vector<std::complex<double>> &a, bool inverse)
+{
+    const std::size_t n = a.size();
+    for (std::size_t i = 1, j = 0; i < n; ++i)
+    {
+        std::size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j)
+            std::swap(a[i], a[j]);
+    }
+    for (std::size_t len = 2; len <= n; len <<= 1)
+    {
+        const double angle = 2.0 * M_PI / len * (inverse ? 1.0 : -1.0);
+        const std::complex<double> wlen(std::cos(angle), std::sin(angle));
+        for (std::size_t i = 0; i < n; i += len)
+        {
+            std::complex<double> w(1.0, 0.0);
+            for (std::size_t k = 0; k < len / 2; ++k)
+            {
+                std::complex<double> u = a[i + k], v = a[i + k + len / 2] * w;
+                a[i + k] = u + v;
+                a[i + k + len / 2] = u - v;
+                w *= wlen;
+            }
+        }
+    }
 }
 
-// Returns a single bootstrap sample from a vector of double
-inline std::vector<double> bootstrap_generate_sample(const std::vector<double>& data)
+// Fills result[m] = sum_j x_j x_{j+m} (x is zero past its end) for every lag m < result.size(), in O(n log n)
+void correlate_fft(std::span<const double> x, std::span<double> result)
+{
+    std::size_t size = 1;
+    while (size < x.size() + result.size())
+        size <<= 1;
+    std::vector<std::complex<double>> a(size, 0.0);
+    std::copy(x.begin(), x.end(), a.begin());
+    fft(a, false);
+    for (auto &z : a)
+        z = std::norm(z);
+    fft(a, true);
+    for (std::size_t m = 0; m < result.size(); ++m)
+        result[m] = m < x.size() ? a[m].real() / size : 0.0;
+}
+
+// Sokal's automatic window: smallest W with W >= c * tau_int(W), tau_int(W) = 1/2 + sum_{t=1}^{W} rho(t).
+// If no lag satisfies it the last lag is returned and *closed (if given) is set to false: rho is too short
+// for the autocorrelation time, which is then underestimated.
+std::size_t autocorr_window(std::span<const double> rho, double c = 6.0, bool *closed = nullptr)
+{
+    double tauInt = 0.5;
+    for (std::size_t w = 1; w < rho.size(); ++w)
+    {
+        tauInt += rho[w];
+        if (static_cast<double>(w) >= c * tauInt)
+        {
+            if (closed)
+                *closed = true;
+            return w;
+        }
+    }
+    if (closed)
+        *closed = false;
+    return rho.empty() ? 0 : rho.size() - 1;
+}
+
+/**
+ * @brief Madras-Sokal error bars of the normalized autocorrelation function.
+ *
+ * @param[in] rho Normalized autocorrelation rho(t) = c_t / c_0 for t < rho.size(), e.g. from autoCorrel_coefficients.
+ * @param[in] n Length of the series rho was computed from.
+ * @param[out] errors Caller-provided buffer (size rho.size()) for the standard error of every rho(t).
+ * @param[in] c Window constant of autocorr_window.
+ * @param[out] closed Optional flag set to false if the window condition was never met (see autocorr_window).
+ *
+ * @return The window W.
+ *
+ * @details Var[rho(t)] = (1/n) sum_{k>=1} [rho(k+t) + rho(k-t) - 2 rho(k) rho(t)]^2, with
+ * rho(-t) = rho(t) and rho truncated beyond the automatic window W, where it is noise
+ * (Madras-Sokal's cutoff Lambda = W). Expanding the square leaves prefix sums of
+ * rho^2 and the correlations sum_k rho(k) rho(k+m), one-sided and of the symmetric
+ * extension, which are evaluated for every lag with one FFT each: all errors cost
+ * O(W log W + rho.size()) instead of O(rho.size() * W).
+ */
+std::size_t autocorr_errors(std::span<const double> rho, std::size_t n, std::span<double> errors, double c = 6.0,
+                            bool *closed = nullptr)
+{
+    const std::size_t T = rho.size();
+    if (closed)
+        *closed = false;
+    if (T == 0 || n == 0)
+        return 0;
+    const std::size_t W = autocorr_window(rho, c, closed);
+    auto r = [&](std::size_t t) { return t <= W ? rho[t] : 0.0; }; // Truncated rho
+
+    // P[t] = sum_{j<=t} r(j)^2 (constant beyond W)
+    std::vector<double> P(W + 1);
+    for (std::size_t j = 0; j <= W; ++j)
+        P[j] = (j ? P[j - 1] : 0.0) + rho[j] * rho[j];
+    auto prefix = [&](long long t) { return t < 0 ? 0.0 : P[std::min<std::size_t>(t, W)]; };
+    const double S2 = P[W], r0 = rho[0];
+
+    // Q(m) = sum_{k>=0} r(k) r(k+m), R(m) = sum_{j in Z} r(|j|) r(|j+m|)
+    std::vector<double> Q(W + 1), R(2 * W + 1), symmetric(2 * W + 1);
+    correlate_fft(rho.first(W + 1), Q);
+    for (std::size_t j = 0; j <= W; ++j)
+        symmetric[W - j] = symmetric[W + j] = rho[j];
+    correlate_fft(symmetric, R);
+    auto at = [](const std::vector<double> &v, std::size_t m) { return m < v.size() ? v[m] : 0.0; };
+
+    for (std::size_t t = 0; t < T; ++t)
+    {
+        const double rt = rho[t], rtt = r(t);
+        const double sumA2 = S2 - prefix(t);                                       // sum_k r(k+t)^2
+        const double sumB2 = S2 + prefix(static_cast<long long>(t) - 1) - r0 * r0;  // sum_k r(k-t)^2
+        const double sumK2 = S2 - r0 * r0;                                         // sum_k r(k)^2
+        const double sumAB = 0.5 * (at(R, 2 * t) - rtt * rtt);                     // sum_k r(k+t) r(k-t)
+        const double sumAK = at(Q, t) - r0 * rtt;                                  // sum_k r(k+t) r(k)
+        const double sumBK = at(R, t) - r0 * rtt - sumAK;                          // sum_k r(k-t) r(k)
+        double var = sumA2 + sumB2 + 4.0 * rt * rt * sumK2 + 2.0 * sumAB - 4.0 * rt * (sumAK + sumBK);
+        errors[t] = std::sqrt(std::max(var, 0.0) / static_cast<double>(n));
+    }
+    return W;
+}
+
+// Integrated autocorrelation time 1/2 + sum_{t=1}^{W} rho(t) within the window W
+double integrated_autocorr_time(std::span<const double> rho, std::size_t W)
+{
+    double tauInt = 0.5;
+    for (std::size_t t = 1; t <= W && t < rho.size(); ++t)
+        tauInt += rho[t];
+    return tauInt;
+}
+
+
+// Reduction mode of the parallel kernels below
+enum class Reduction
+{
+    Fast,         // One contiguous chunk per thread, partial sums added in completion order
+    Reproducible  // Fixed-size blocks combined by a fixed pairwise tree: bit-identical for any thread count
+};
+
+// ReduceParams struct selecting the threads and the reduction mode of a parallel kernel
+struct ReduceParams
+{
+    int numThreads = 1;
+    Reduction mode = Reduction::Reproducible;
+    std::size_t blockSize = 4096; // Elements per block in Reproducible mode; fixes the shape of the reduction tree
+};
+
+/**
+ * @brief Parallel reduction of block(begin, end) partial results over [0, n).
+ *
+ * @param[in] n Number of elements.
+ * @param[in] granularity Every block boundary is a multiple of it (e.g. the bin size).
+ * @param[in] rp Threads and reduction mode.
+ * @param[in] block Callable returning the Partial of the elements [begin, end); Partial must support +=.
+ *
+ * @return The combined Partial.
+ *
+ * @details Reproducible: the blocks depend only on n, blockSize and granularity, each
+ * block is reduced sequentially by whichever thread takes it, and the block results
+ * are combined as partial[i] += partial[i + w] for w = 1, 2, 4, ... Neither the
+ * thread count nor the scheduling changes a single rounding, so the result is
+ * bit-identical for any numThreads. With a single block it is the sequential sum.
+ * Fast: one chunk per thread, added to the total as threads finish; the rounding
+ * depends on the thread count and on the order the threads finish in.
+ */
+template <typename Partial, typename BlockFn>
+Partial parallel_reduce(std::size_t n, std::size_t granularity, const ReduceParams &rp, const BlockFn &block)
+{
+    granularity = std::max<std::size_t>(granularity, 1);
+    const int numThreads = std::max(rp.numThreads, 1);
+    if (n == 0)
+        return Partial{};
+
+    if (rp.mode == Reduction::Fast)
+    {
+        std::size_t units = (n + granularity - 1) / granularity;
+        std::size_t chunks = std::min<std::size_t>(numThreads, units);
+        if (chunks <= 1)
+            return block(0, n);
+
+        Partial total{};
+        std::mutex mtx;
+        std::vector<std::thread> pool;
+        for (std::size_t c = 0; c < chunks; ++c)
+        {
+            pool.emplace_back([&, c]()
+                              {
+                std::size_t begin = std::min(n, (units * c / chunks) * granularity);
+                std::size_t end = std::min(n, (units * (c + 1) / chunks) * granularity);
+                Partial partial = block(begin, end);
+                std::lock_guard<std::mutex> lock(mtx);
+                total += partial; });
+        }
+        for (auto &t : pool)
+            t.join();
+        return total;
+    }
+
+    const std::size_t blockLen = std::max<std::size_t>(1, (rp.blockSize + granularity - 1) / granularity) * granularity;
+    const std::size_t nBlocks = (n + blockLen - 1) / blockLen;
+    std::vector<Partial> partials(nBlocks);
+    std::atomic<std::size_t> next{0};
+    auto worker = [&]()
+    {
+        for (std::size_t b = next++; b < nBlocks; b = next++)
+            partials[b] = block(b * blockLen, std::min(n, (b + 1) * blockLen));
+    };
+
+    int threads = std::min<int>(numThreads, static_cast<int>(nBlocks));
+    if (threads <= 1)
+    {
+        worker();
+    }
+    else
+    {
+        std::vector<std::thread> pool;
+        for (int t = 0; t < threads; ++t)
+            pool.emplace_back(worker);
+        for (auto &t : pool)
+            t.join();
+    }
+
+    for (std::size_t width = 1; width < nBlocks; width *= 2)
+        for (std::size_t i = 0; i + width < nBlocks; i += 2 * width)
+            partials[i] += partials[i + width];
+    return partials[0];
+}
+
+// Parallel version of mean
+template <typename Series>
+accum_t<element_t<Series>> mean(const Series &x, const ReduceParams &rp)
+{
+    using A = accum_t<element_t<Series>>;
+    A sum = parallel_reduce<A>(x.size(), 1, rp, [&](std::size_t begin, std::size_t end)
+                               {
+        A s = 0.0;
+        for (std::size_t i = begin; i < end; ++i)
+            s += static_cast<A>(x[i]);
+        return s; });
+    return sum / static_cast<double>(x.size());
+}
+
+// Parallel version of variance, E[|X|^2] - |E[X]|^2
+template <typename Series>
+double variance(const Series &data, const ReduceParams &rp)
+{
+    if (data.size() == 0) {
+        std::cerr << "Error: Data vector is empty.\n";
+        return 0.0;
+    }
+    double meanOfSquares = parallel_reduce<double>(data.size(), 1, rp, [&](std::size_t begin, std::size_t end)
+                                                   {
+        double s = 0.0;
+        for (std::size_t i = begin; i < end; ++i)
+            s += abs2(static_cast<accum_t<element_t<Series>>>(data[i]));
+        return s; }) / data.size();
+    return meanOfSquares - abs2(mean(data, rp));
+}
+
+// Parallel version of jack_error
+template <typename Series>
+double jack_error(const Series &data, const ReduceParams &rp)
+{
+    using A = accum_t<element_t<Series>>;
+    const std::size_t n = data.size();
+    A m = mean(data, rp);
+    A total = m * static_cast<double>(n);
+    double sumsq = parallel_reduce<double>(n, 1, rp, [&](std::size_t begin, std::size_t end)
+                                           {
+        double s = 0.0;
+        for (std::size_t i = begin; i < end; ++i)
+            s += abs2((total - static_cast<A>(data[i])) / static_cast<double>(n - 1) - m);
+        return s; });
+    sumsq *= (double)(n - 1) / (double)n;
+    return std::sqrt(sumsq);
+}
+
+// Parallel version of auto_correl around a precomputed mean
+template <typename Series>
+accum_t<element_t<Series>> auto_correl(const Series &x, int tau, accum_t<element_t<Series>> x_mean, const ReduceParams &rp)
+{
+    using A = accum_t<element_t<Series>>;
+    const std::size_t pairs = x.size() > static_cast<std::size_t>(tau) ? x.size() - tau : 0;
+    A c_tau = parallel_reduce<A>(pairs, 1, rp, [&](std::size_t begin, std::size_t end)
+                                 {
+        A s = 0.0;
+        for (std::size_t i = begin; i < end; ++i)
+            s += conj_if_complex(static_cast<A>(x[i]) - x_mean) * (static_cast<A>(x[i + tau]) - x_mean);
+        return s; });
+    return c_tau / static_cast<double>(pairs);
+}
+
+// Partial sums of summarize_series over a range of whole bins
+template <typename A>
+struct SummaryPartial
+{
+    A sum = 0.0, binSum = 0.0;       // Shifted raw / binned values
+    double sumSq = 0.0, binSumSq = 0.0;
+
+    SummaryPartial &operator+=(const SummaryPartial &other)
+    {
+        sum += other.sum;
+        binSum += other.binSum;
+        sumSq += other.sumSq;
+        binSumSq += other.binSumSq;
+        return *this;
+    }
+};
+
+// Parallel version of summarize_series; blocks hold whole bins, so the binned series is the same
+template <typename Series>
+SeriesSummary<element_t<Series>> summarize_series(const Series& data, int bin_size, const ReduceParams &rp)
+{
+    using T = element_t<Series>;
+    using A = accum_t<T>;
+    SeriesSummary<T> summary;
+    const std::size_t n = data.size();
+    summary.size = n;
+    if (n == 0) {
+        std::cerr << "Error: Data vector is empty.\n";
+        return summary;
+    }
+    bin_size = std::max(bin_size, 1);
+    summary.binned.resize((n + bin_size - 1) / bin_size);
+
+    const A shift = static_cast<A>(data[0]);
+    SummaryPartial<A> total = parallel_reduce<SummaryPartial<A>>(n, bin_size, rp, [&](std::size_t begin, std::size_t end)
+                                                                 {
+        SummaryPartial<A> p;
+        for (std::size_t b0 = begin; b0 < end; b0 += bin_size)
+        {
+            std::size_t b1 = std::min(b0 + bin_size, end);
+            A binAcc = 0.0;
+            for (std::size_t i = b0; i < b1; ++i)
+            {
+                A y = static_cast<A>(data[i]) - shift;
+                p.sum += y;
+                p.sumSq += abs2(y);
+                binAcc += static_cast<A>(data[i]);
+            }
+            T b = static_cast<T>(binAcc / static_cast<double>(b1 - b0));
+            summary.binned[b0 / bin_size] = b;
+            A y = static_cast<A>(b) - shift;
+            p.binSum += y;
+            p.binSumSq += abs2(y);
+        }
+        return p; });
+
+    A m = total.sum / static_cast<double>(n);
+    double sumDevSq = std::max(total.sumSq - n * abs2(m), 0.0);
+
+    summary.mean = shift + m;
+    summary.variance = sumDevSq / n;
+    summary.jackErr = n > 1 ? std::sqrt(sumDevSq / (double(n) * double(n - 1))) : 0.0;
+
+    const double nb = summary.binned.size();
+    A mb = total.binSum / nb;
+    summary.binnedMean = shift + mb;
+    summary.c_0 = std::max(total.binSumSq / nb - abs2(mb), 0.0);
+
+    return summary;
+}
+
+
+// Fills the caller-provided buffer bootstrapSample with a bootstrap sample of data
+template <typename Series, typename T, typename Generator>
+inline void bootstrap_generate_sample(const Series& data, std::span<T> bootstrapSample, Generator& gen)
+{
+    std::uniform_int_distribution<std::size_t> dist(0, data.size() - 1);
+
+    // Create a bootstrap sample by randomly selecting elements with replacement
+    for (std::size_t i = 0; i < bootstrapSample.size(); ++i) {
+        bootstrapSample[i] = data[dist(gen)];
+    }
+}
+
+// Returns a single bootstrap sample from a series
+template <typename Series>
+inline std::vector<element_t<Series>> bootstrap_generate_sample(const Series& data)
 {
     // Random number generator with a non-deterministic seed
     std::random_device rd;
     std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dist(0, data.size() - 1);
-
-    // Create a bootstrap sample by randomly selecting elements with replacement
-    std::vector<double> bootstrapSample;
-    bootstrapSample.reserve(data.size());  // Reserve space for efficiency
 
-    for (std::size_t i = 0; i < data.size(); ++i) {
-        int index = dist(gen);
-        bootstrapSample.push_back(data[index]);
-    }
+    std::vector<element_t<Series>> bootstrapSample(data.size());
+    bootstrap_generate_sample(data, std::span<element_t<Series>>(bootstrapSample), gen);
 
     return bootstrapSample;
 }
 
 
 // Bootstrap estimate of Standard Error
-inline double bootstrap_stdError(const std::vector<double>& bootstrapEstimates)
+template <typename Series>
+inline double bootstrap_stdError(const Series& bootstrapEstimates)
 {
   /* Bootstrap estimate of standard error base on 
    * Efron, B., & Tibshirani, R.J. (1994). An Introduction to the Bootstrap (1st ed.). Chapman and Hall/CRC (p.48)
@@ -181,11 +817,13 @@ inline double bootstrap_stdError(const std::vector<double>& bootstrapEstimates)
    * Useful links: https://yuleii.github.io/2021/01/22/bootstrap.html
    */
   
-  double meanEstimate = mean(bootstrapEstimates);
+  using A = accum_t<element_t<Series>>;
+  A meanEstimate = mean(bootstrapEstimates);
 
   double sumSquaredDifferences = 0.0;
-  for (double estimate : bootstrapEstimates) {
-        sumSquaredDifferences += (estimate - meanEstimate) * (estimate - meanEstimate);
+  for (std::size_t i = 0; i < bootstrapEstimates.size(); ++i) {
+        A estimate = static_cast<A>(bootstrapEstimates[i]);
+        sumSquaredDifferences += abs2(estimate - meanEstimate);
     }
 
     // Standard error calculation based on the formula in the image
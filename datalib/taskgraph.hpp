@@ -0,0 +1,290 @@
+#ifndef TASKGRAPH_HPP
+#define TASKGRAPH_HPP
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <exception>
+#include <algorithm>
+
+// Stage struct: one node of the analysis graph with the named data it consumes and produces
+struct Stage
+{
+	std::string name;
+	std::vector<std::string> inputs;	// Names of the data the stage needs, each produced by exactly one stage
+	std::vector<std::string> outputs; // Names of the data the stage produces
+	std::function<void()> run;
+
+	// Filled by TaskGraph::run (initialized here so that add_stage can aggregate-initialize the first members)
+	std::vector<size_t> dependencies{}; // Stages producing the inputs
+	double start = 0.0, end = 0.0;		// Wall-clock times in ms since the start of the run
+	bool done = false, failed = false;
+};
+
+/**
+ * @brief Task-graph scheduler running the stages of an analysis on a thread pool as soon as their inputs exist.
+ *
+ * @details Stages declare their inputs and outputs by name; a stage depends on the
+ * stages producing its inputs and becomes ready when they have all finished. Ready
+ * stages run concurrently, so e.g. the statistics of one observable start as soon as
+ * its column is read, while the other column is still being read. Data is passed
+ * through variables captured by the stage functions: a stage may only touch what it
+ * declares, which is what makes the concurrency safe. A stage that throws is reported
+ * and its dependents are skipped.
+ */
+class TaskGraph
+{
+public:
+	// Adds a stage and returns its index
+	size_t add_stage(const std::string &name,
+									 const std::vector<std::string> &inputs,
+									 const std::vector<std::string> &outputs,
+									 std::function<void()> run)
+	{
+		stages.push_back({name, inputs, outputs, std::move(run)});
+		return stages.size() - 1;
+	}
+
+	/**
+	 * @brief Runs every stage once its dependencies have finished.
+	 *
+	 * @param[in] numThreads Number of worker threads (0 for all hardware threads).
+	 *
+	 * @return True if every stage ran successfully, false on a graph error or a failed stage.
+	 */
+	bool run(int numThreads = 0)
+	{
+		if (!resolve_dependencies())
+			return false;
+
+		std::vector<size_t> pending(stages.size());
+		std::vector<std::vector<size_t>> dependents(stages.size());
+		std::deque<size_t> ready;
+		for (size_t s = 0; s < stages.size(); ++s)
+		{
+			pending[s] = stages[s].dependencies.size();
+			for (size_t d : stages[s].dependencies)
+				dependents[d].push_back(s);
+			if (pending[s] == 0)
+				ready.push_back(s);
+		}
+
+		std::mutex mtx;
+		std::condition_variable cv;
+		size_t finished = 0;
+		bool ok = true;
+		const auto t0 = std::chrono::steady_clock::now();
+		auto elapsed = [&]
+		{ return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count(); };
+
+		auto worker = [&]()
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			while (true)
+			{
+				cv.wait(lock, [&]
+								{ return !ready.empty() || finished == stages.size(); });
+				if (finished == stages.size())
+					return;
+				size_t s = ready.front();
+				ready.pop_front();
+
+				Stage &stage = stages[s];
+				bool skip = std::any_of(stage.dependencies.begin(), stage.dependencies.end(),
+																[&](size_t d)
+																{ return stages[d].failed; });
+				lock.unlock();
+
+				stage.start = elapsed();
+				if (skip)
+				{
+					stage.failed = true;
+					std::cerr << "Stage " << stage.name << " skipped: an input stage failed" << std::endl;
+				}
+				else
+				{
+					try
+					{
+						stage.run();
+					}
+					catch (const std::exception &e)
+					{
+						stage.failed = true;
+						std::cerr << "Stage " << stage.name << " failed: " << e.what() << std::endl;
+					}
+					catch (...)
+					{
+						stage.failed = true;
+						std::cerr << "Stage " << stage.name << " failed: unknown exception" << std::endl;
+					}
+				}
+				stage.end = elapsed();
+
+				lock.lock();
+				stage.done = true;
+				ok = ok && !stage.failed;
+				finished++;
+				for (size_t d : dependents[s])
+				{
+					if (--pending[d] == 0)
+						ready.push_back(d);
+				}
+				cv.notify_all();
+			}
+		};
+
+		if (numThreads <= 0)
+			numThreads = std::max(1u, std::thread::hardware_concurrency());
+		numThreads = std::max(1, std::min<int>(numThreads, static_cast<int>(stages.size())));
+		std::vector<std::thread> pool;
+		for (int t = 0; t < numThreads; ++t)
+			pool.emplace_back(worker);
+		for (auto &t : pool)
+			t.join();
+
+		wallTime = elapsed();
+		return ok;
+	}
+
+	/**
+	 * @brief Prints the duration of every stage and the critical path of the last run.
+	 *
+	 * @details The critical path is the chain of dependent stages with the largest total
+	 * duration: no number of threads can finish the run faster. Slack is how much a
+	 * stage could be delayed without lengthening the critical path; stages on the path
+	 * have zero slack and are marked with '*'.
+	 */
+	void print_report(std::ostream &os = std::cout) const
+	{
+		// Earliest finish of every stage, relaxed in topological order
+		std::vector<size_t> order = topological_order();
+		std::vector<double> earliestFinish(stages.size(), 0.0), latestFinish(stages.size(), 0.0);
+		std::vector<size_t> previous(stages.size(), stages.size());
+		double pathLength = 0.0, busy = 0.0;
+		size_t last = stages.size();
+		for (size_t s : order)
+		{
+			double startAt = 0.0;
+			for (size_t d : stages[s].dependencies)
+			{
+				if (earliestFinish[d] > startAt)
+				{
+					startAt = earliestFinish[d];
+					previous[s] = d;
+				}
+			}
+			earliestFinish[s] = startAt + duration(s);
+			busy += duration(s);
+			if (earliestFinish[s] >= pathLength)
+			{
+				pathLength = earliestFinish[s];
+				last = s;
+			}
+		}
+
+		std::fill(latestFinish.begin(), latestFinish.end(), pathLength);
+		for (auto it = order.rbegin(); it != order.rend(); ++it)
+		{
+			for (size_t d : stages[*it].dependencies)
+				latestFinish[d] = std::min(latestFinish[d], latestFinish[*it] - duration(*it));
+		}
+
+		std::vector<bool> critical(stages.size(), false);
+		for (size_t s = last; s < stages.size(); s = previous[s])
+			critical[s] = true;
+
+		os << "# stage report: wall " << wallTime << " ms, busy " << busy << " ms, critical path " << pathLength << " ms\n"
+			 << "#   " << std::left << std::setw(28) << "stage" << std::right
+			 << std::setw(12) << "start" << std::setw(12) << "duration" << std::setw(12) << "slack" << "  (ms)\n";
+		for (size_t s : order)
+		{
+			os << "# " << (critical[s] ? "* " : "  ") << std::left << std::setw(28) << stages[s].name << std::right << std::fixed << std::setprecision(2)
+				 << std::setw(12) << stages[s].start << std::setw(12) << duration(s) << std::setw(12) << std::max(latestFinish[s] - earliestFinish[s], 0.0)
+				 << (stages[s].failed ? "  failed" : "") << "\n";
+		}
+		os << std::defaultfloat << std::setprecision(6) << std::flush;
+	}
+
+	const std::vector<Stage> &get_stages() const { return stages; }
+
+private:
+	double duration(size_t s) const { return stages[s].end - stages[s].start; }
+
+	// Links every input to its producer; reports missing producers, duplicated outputs and cycles
+	bool resolve_dependencies()
+	{
+		std::map<std::string, size_t> producer;
+		for (size_t s = 0; s < stages.size(); ++s)
+		{
+			for (const auto &output : stages[s].outputs)
+			{
+				if (!producer.emplace(output, s).second)
+				{
+					std::cerr << "Error: " << output << " is produced by both " << stages[producer[output]].name
+										<< " and " << stages[s].name << std::endl;
+					return false;
+				}
+			}
+		}
+
+		for (auto &stage : stages)
+		{
+			stage.dependencies.clear();
+			for (const auto &input : stage.inputs)
+			{
+				auto it = producer.find(input);
+				if (it == producer.end())
+				{
+					std::cerr << "Error: no stage produces " << input << ", needed by " << stage.name << std::endl;
+					return false;
+				}
+				if (std::find(stage.dependencies.begin(), stage.dependencies.end(), it->second) == stage.dependencies.end())
+					stage.dependencies.push_back(it->second);
+			}
+		}
+
+		if (topological_order().size() != stages.size())
+		{
+			std::cerr << "Error: the stage graph has a cycle" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	// Kahn's algorithm; stages on a cycle are left out
+	std::vector<size_t> topological_order() const
+	{
+		std::vector<size_t> pending(stages.size()), order;
+		std::vector<std::vector<size_t>> dependents(stages.size());
+		for (size_t s = 0; s < stages.size(); ++s)
+		{
+			pending[s] = stages[s].dependencies.size();
+			for (size_t d : stages[s].dependencies)
+				dependents[d].push_back(s);
+			if (pending[s] == 0)
+				order.push_back(s);
+		}
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			for (size_t d : dependents[order[i]])
+			{
+				if (--pending[d] == 0)
+					order.push_back(d);
+			}
+		}
+		return order;
+	}
+
+	std::vector<Stage> stages;
+	double wallTime = 0.0;
+};
+
+#endif // taskgraph.hpp
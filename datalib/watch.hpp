@@ -0,0 +1,628 @@
+#ifndef WATCH_HPP
+#define WATCH_HPP
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <iterator>
+#include <regex>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <filesystem>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include "filehandler.hpp"
+#include "dedup.hpp"
+#include "stattools.hpp"
+#include "binaryio.hpp"
+
+namespace fs = std::filesystem;
+
+/*
+ * Watch mode: during a production run the data directory is watched with inotify and
+ * every configuration file is parsed once, when its writer closes it. Running
+ * accumulators are updated in O(tau_max) per configuration and the outputs are
+ * rewritten atomically (write a temporary file, then rename it over the old one), so
+ * a reader such as a plotting script never sees a half-written file. The sorted raw
+ * file, which grows with the chain, is appended to while configurations arrive in
+ * order and only rewritten when a late one lands in the middle.
+ */
+
+/**
+ * @brief Replaces a file atomically with the output of a writer.
+ *
+ * @param[in] filename The file to be replaced (or created).
+ * @param[in] write Callable writing the new contents to the temporary file name it is given;
+ * it returns true only if the stream was still good after the last write was flushed.
+ *
+ * @return True if the new contents are in place, false otherwise (the old file is left untouched).
+ *
+ * @details The temporary file ".tmp.<name>" lives in the same directory, so the
+ * final rename never crosses a file system and is atomic. A temporary file left over
+ * by an interrupted run is removed first, so a writer that fails to create the file
+ * cannot rename the stale one into place. The file is flushed to disk before the rename.
+ */
+bool replace_file_atomically(const std::string &filename, const std::function<bool(const std::string &)> &write)
+{
+	const fs::path target(filename);
+	const std::string tempName = (target.parent_path() / (".tmp." + target.filename().string())).string();
+	if (::unlink(tempName.c_str()) != 0 && errno != ENOENT)
+	{
+		std::cerr << "Error removing stale " << tempName << ": " << std::strerror(errno) << std::endl;
+		return false;
+	}
+	if (!write(tempName))
+	{
+		std::cerr << "Error: " << tempName << " was not written, " << filename << " is left unchanged" << std::endl;
+		::unlink(tempName.c_str());
+		return false;
+	}
+
+	int fd = ::open(tempName.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		std::cerr << "Error: " << tempName << " was not written" << std::endl;
+		return false;
+	}
+	const bool synced = ::fsync(fd) == 0;
+	::close(fd);
+	if (!synced)
+	{
+		std::cerr << "Error flushing " << tempName << " to disk: " << std::strerror(errno) << std::endl;
+		::unlink(tempName.c_str());
+		return false;
+	}
+
+	if (::rename(tempName.c_str(), filename.c_str()) != 0)
+	{
+		std::cerr << "Error renaming " << tempName << " to " << filename << ": " << std::strerror(errno) << std::endl;
+		::unlink(tempName.c_str());
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Watches a directory for data files that have been completely written.
+ *
+ * @details A file is reported when its writer closes it (IN_CLOSE_WRITE) or when it
+ * is renamed into the directory (IN_MOVED_TO), never while it is still being written.
+ * If the kernel event queue overflows, overflowed() is set and the caller should
+ * rescan the directory.
+ */
+class DirectoryWatcher
+{
+public:
+	DirectoryWatcher(const std::string &directoryPath, const std::string &fileType)
+			: directory(directoryPath), extension(fileType)
+	{
+		fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (fd < 0 || ::inotify_add_watch(fd, directoryPath.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+		{
+			std::cerr << "Error watching " << directoryPath << ": " << std::strerror(errno) << std::endl;
+		}
+	}
+
+	~DirectoryWatcher()
+	{
+		if (fd >= 0)
+			::close(fd);
+	}
+
+	DirectoryWatcher(const DirectoryWatcher &) = delete;
+	DirectoryWatcher &operator=(const DirectoryWatcher &) = delete;
+
+	bool ok() const { return fd >= 0; }
+
+	// Waits up to timeoutMs for new files and returns them together with those arriving meanwhile (empty on timeout)
+	std::vector<fs::path> wait(int timeoutMs)
+	{
+		std::vector<fs::path> files;
+		struct pollfd pfd = {fd, POLLIN, 0};
+		if (::poll(&pfd, 1, timeoutMs) <= 0)
+			return files;
+
+		alignas(struct inotify_event) char buffer[16 * 1024];
+		while (true)
+		{
+			ssize_t length = ::read(fd, buffer, sizeof(buffer));
+			if (length <= 0)
+				break; // EAGAIN: every queued event has been read
+			for (ssize_t offset = 0; offset < length;)
+			{
+				const auto *event = reinterpret_cast<const struct inotify_event *>(buffer + offset);
+				if (event->mask & IN_Q_OVERFLOW)
+					overflow = true;
+				else if (event->len > 0 && !(event->mask & IN_ISDIR))
+				{
+					fs::path path = fs::path(directory) / event->name;
+					if (path.extension() == extension)
+						files.push_back(path);
+				}
+				offset += sizeof(struct inotify_event) + event->len;
+			}
+		}
+		return files;
+	}
+
+	// True once after the event queue overflowed
+	bool overflowed()
+	{
+		bool o = overflow;
+		overflow = false;
+		return o;
+	}
+
+private:
+	std::string directory, extension;
+	int fd = -1;
+	bool overflow = false;
+};
+
+// Running mean, variance and jackknife error of a chain, with blocking levels and the autocorrelation of the binned series
+struct LiveObservable
+{
+	/**
+	 * Every push is O(tau_max) (the lag sums of StreamingAutoCorrel) plus O(1) amortized
+	 * for the blocking levels, whatever the length of the chain.
+	 *
+	 * Blocking levels: level k holds the means of consecutive blocks of 2^k values, and
+	 * its error estimate sqrt(var_k / (nBlocks_k - 1)) grows with k until the blocks are
+	 * longer than the autocorrelation time, where it reaches a plateau.
+	 */
+	LiveObservable(const std::string &name, int colToRead, int bin_size, int tau_max)
+			: name(name), colToRead(colToRead), bin_size(std::max(bin_size, 1)), tau_max(tau_max), binned(tau_max) {}
+
+	void push(double x)
+	{
+		if (n == 0)
+			shift = x;
+		double y = x - shift;
+		sum += y;
+		sumSq += y * y;
+		n++;
+
+		binAcc += x;
+		if (++inBin == bin_size)
+		{
+			binned.push(binAcc / bin_size);
+			binAcc = 0.0;
+			inBin = 0;
+		}
+
+		// Carry completed blocks up the levels
+		double block = y;
+		for (size_t k = 0;; ++k)
+		{
+			if (k == levels.size())
+				levels.push_back({});
+			Level &level = levels[k];
+			level.nBlocks++;
+			level.sum += block;
+			level.sumSq += block * block;
+			if (!level.hasPending)
+			{
+				level.pending = block;
+				level.hasPending = true;
+				break;
+			}
+			block = 0.5 * (level.pending + block);
+			level.hasPending = false;
+		}
+	}
+
+	void reset() { *this = LiveObservable(name, colToRead, bin_size, tau_max); }
+
+	long long size() const { return n; }
+	long long num_bins() const { return binned.size(); }
+
+	// Same as summarize_series(data, bin_size): mean, variance and jackknife error
+	double mean() const { return shift + sum / n; }
+	double variance() const { return sum_dev_sq() / n; }
+	double jack_error() const { return n > 1 ? std::sqrt(sum_dev_sq() / (double(n) * double(n - 1))) : 0.0; }
+
+	// (tau, c_tau / c_0) of the complete bins for tau < min(tau_max, number of bins)
+	std::vector<std::pair<int, double>> autocorrelation() const
+	{
+		std::vector<std::pair<int, double>> corrCoefPair;
+		if (binned.size() > 0)
+			binned.coefficients(corrCoefPair);
+		return corrCoefPair;
+	}
+
+	// (block size, number of blocks, error of the mean) of every level with at least two blocks
+	std::vector<std::tuple<long long, long long, double>> blocking_levels() const
+	{
+		std::vector<std::tuple<long long, long long, double>> result;
+		for (size_t k = 0; k < levels.size() && levels[k].nBlocks > 1; ++k)
+		{
+			const Level &level = levels[k];
+			double m = level.sum / level.nBlocks;
+			double var = std::max(level.sumSq / level.nBlocks - m * m, 0.0);
+			result.emplace_back(1LL << k, level.nBlocks, std::sqrt(var / (level.nBlocks - 1)));
+		}
+		return result;
+	}
+
+	std::string name;
+	int colToRead;
+
+private:
+	struct Level
+	{
+		long long nBlocks = 0;
+		double sum = 0.0, sumSq = 0.0; // Of the shifted block means
+		double pending = 0.0;          // First half of the next block of the level above
+		bool hasPending = false;
+	};
+
+	// sum_i (x_i - mean)^2
+	double sum_dev_sq() const
+	{
+		double m = sum / n;
+		return std::max(sumSq - n * m * m, 0.0);
+	}
+
+	int bin_size, tau_max;
+	StreamingAutoCorrel binned;
+	std::vector<Level> levels;
+	double shift = 0.0, sum = 0.0, sumSq = 0.0, binAcc = 0.0;
+	int inBin = 0;
+	long long n = 0;
+};
+
+// WatchParams struct to configure the watch mode
+struct WatchParams
+{
+	int bin_size = 1;
+	int tau_max = 100;                             // Lags of the live autocorrelation; every configuration costs O(tau_max)
+	bool deduplicate = true;                       // Skip files whose contents duplicate another file
+	OutputFormat format = OutputFormat::Text;      // Format of the autocorrelation files
+	int idleSeconds = 0;                           // Stop after this many seconds without new files (0 to run until SIGINT/SIGTERM)
+};
+
+/**
+ * @brief Live version of the ingest and autocorrelation stages, fed one data file at a time.
+ *
+ * @details Rows are kept sorted by configuration number. A file whose configuration is
+ * past every other one (the usual case during a run) only updates the accumulators
+ * and is appended to the sorted raw file; a late or rewritten configuration makes the
+ * accumulators replay the whole chain once before the next write, since the chain
+ * order changed, and the sorted raw file is then rewritten atomically.
+ */
+class LiveAnalysis
+{
+public:
+	// columns: name and column of the sorted file of every observable (column p + 1 holds patterns[p])
+	LiveAnalysis(const std::vector<std::string> &patterns,
+							 const std::vector<std::pair<std::string, int>> &columns,
+							 const WatchParams &params)
+			: patterns(patterns), params(params)
+	{
+		for (const auto &[name, colToRead] : columns)
+		{
+			observables.emplace_back(name, colToRead, params.bin_size, params.tau_max);
+		}
+	}
+
+	/**
+	 * @brief Parses one data file and adds its rows.
+	 *
+	 * @param[in] path The data file.
+	 *
+	 * @return True if the rows changed, false if the file was skipped.
+	 */
+	bool add_file(const fs::path &path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+		{
+			std::cerr << "Error opening file: " << path << std::endl;
+			return false;
+		}
+		std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+		const std::string fileName = path.filename().string();
+		std::smatch match;
+		if (!std::regex_search(fileName, match, landauRegex))
+		{
+			std::cerr << "Pattern not found in file name: " << fileName << std::endl;
+			return false;
+		}
+		const int config = std::stoi(match[1]);
+
+		if (params.deduplicate)
+		{
+			auto [it, inserted] = contentOwner.emplace(hash_block(contents.data(), contents.size()), fileName);
+			if (!inserted && it->second != fileName)
+			{
+				std::cerr << "Skipping duplicate file: " << path << " (same contents as " << it->second << ")" << std::endl;
+				return false;
+			}
+		}
+
+		MatchData fileData = extract_pattern_values_from_buffer(contents, fileName, patterns);
+		if (!match_data_has_values(fileData))
+		{
+			std::cerr << "No values found for the specified patterns in file: " << path << std::endl;
+			return false;
+		}
+
+		const std::pair<int, std::string> key(config, fileName);
+		const bool appended = !stale && (rows.empty() || rows.rbegin()->first < key);
+		FileRows &fileRows = rows[key];
+		fileRows.values = file_rows(config, fileData);
+		fileRows.text = format_rows(fileRows.values);
+		if (appended)
+		{
+			push_rows(fileRows.values);
+			appendedText += fileRows.text;
+		}
+		else
+			stale = true;
+		return true;
+	}
+
+	std::size_t num_files() const { return rows.size(); }
+
+	/**
+	 * @brief Updates the sorted raw file and atomically rewrites, per observable, the autocorrelation and blocking files.
+	 *
+	 * @param[in] outputDirectory Directory of the outputs.
+	 * @param[in] sortedFileName Name of the sorted raw file, e.g. sorted_raw_GP0000.dat.
+	 */
+	void write_outputs(const std::string &outputDirectory, const std::string &sortedFileName)
+	{
+		if (stale)
+		{
+			for (auto &obs : observables)
+				obs.reset();
+			for (const auto &[_, fileRows] : rows)
+				push_rows(fileRows.values);
+			stale = false;
+			rewriteSorted = true;
+		}
+
+		// Rows past the end of the chain are appended; anything else (or a failed append) rewrites the whole file
+		const std::string sortedFile = outputDirectory + sortedFileName;
+		if (rewriteSorted)
+		{
+			rewriteSorted = !replace_file_atomically(sortedFile, [&](const std::string &tempName)
+																							 {
+				std::ofstream outFile(tempName);
+				for (const auto &[_, fileRows] : rows)
+				{
+					outFile << fileRows.text;
+				}
+				outFile.flush();
+				return outFile.good(); });
+		}
+		else if (!appendedText.empty())
+		{
+			std::ofstream outFile(sortedFile, std::ios::app);
+			outFile << appendedText;
+			outFile.flush();
+			if (!outFile.good())
+			{
+				std::cerr << "Error appending to " << sortedFile << ", it will be rewritten" << std::endl;
+				rewriteSorted = true;
+			}
+		}
+		appendedText.clear();
+
+		for (const auto &obs : observables)
+		{
+			if (obs.size() == 0)
+				continue;
+
+			const std::vector<std::pair<int, double>> corrCoefPair = obs.autocorrelation();
+			std::vector<double> rho(corrCoefPair.size()), corrErrors(corrCoefPair.size());
+			for (size_t i = 0; i < corrCoefPair.size(); ++i)
+			{
+				rho[i] = corrCoefPair[i].second;
+			}
+			bool windowClosed = true;
+			const std::size_t window = autocorr_errors(rho, obs.num_bins(), corrErrors, 6.0, &windowClosed);
+			const std::vector<std::string> extraInfo = {"# mean: " + obs.name + ": " + std::to_string(obs.mean()),
+																									"# variance: " + obs.name + ": " + std::to_string(obs.variance()),
+																									"# jacknife error: " + obs.name + ": " + std::to_string(obs.jack_error()),
+																									"# tau_int: " + obs.name + ": " + std::to_string(integrated_autocorr_time(rho, window)) +
+																											" (window " + std::to_string(window) +
+																											(windowClosed ? ")" : ", not closed: lower bound, increase watchTauMax)")};
+			const std::string extension = output_extension(params.format);
+			replace_file_atomically(outputDirectory + "autocorr_" + obs.name + extension, [&](const std::string &tempName)
+															{ return write_pair_data(corrCoefPair, tempName.substr(0, tempName.size() - extension.size()),
+																											 {"#tau", "corr_coef", "corr_err"}, extraInfo, params.format, nullptr, corrErrors); });
+
+			replace_file_atomically(outputDirectory + "binning_" + obs.name + ".dat", [&](const std::string &tempName)
+															{
+				std::ofstream outFile(tempName);
+				outFile << "# blocking levels: " << obs.name << " (" << obs.size() << " values)\n\n"
+								<< "#bin_size\t\tbins\t\terror\n";
+				for (const auto &[binSize, bins, error] : obs.blocking_levels())
+				{
+					outFile << binSize << "\t\t" << bins << "\t\t" << error << "\n";
+				}
+				outFile.flush();
+				return outFile.good(); });
+		}
+	}
+
+private:
+	// Rows of one file as the batch ingest writes them: config, then the values of each pattern in the order of patterns,
+	// at the default stream precision
+	std::vector<std::vector<double>> file_rows(int config, const MatchData &fileData) const
+	{
+		const std::vector<double> missing;
+		std::vector<const std::vector<double> *> columns;
+		size_t maxRows = 0;
+		for (const auto &pattern : patterns)
+		{
+			auto it = fileData.values.find(pattern);
+			columns.push_back(it != fileData.values.end() ? &it->second : &missing);
+			maxRows = std::max(maxRows, columns.back()->size());
+		}
+
+		std::vector<std::vector<double>> fileRows(maxRows);
+		for (size_t i = 0; i < maxRows; ++i)
+		{
+			fileRows[i].push_back(config);
+			for (const std::vector<double> *column : columns)
+			{
+				const std::vector<double> &values = *column;
+				if (i >= values.size())
+					break; // A missing value ends the row, as when the batch ingest reads it back
+				std::ostringstream text;
+				text << values[i];
+				fileRows[i].push_back(std::stod(text.str()));
+			}
+		}
+		return fileRows;
+	}
+
+	// Lines of the sorted raw file for the rows of one file, formatted as sort_column_in_file does
+	static std::string format_rows(const std::vector<std::vector<double>> &fileRows)
+	{
+		std::ostringstream text;
+		for (const auto &row : fileRows)
+		{
+			for (size_t i = 0; i < row.size(); ++i)
+			{
+				text << row[i];
+				if (i < row.size() - 1)
+				{
+					text << "\t\t\t ";
+				}
+			}
+			text << "\n";
+		}
+		return text.str();
+	}
+
+	void push_rows(const std::vector<std::vector<double>> &fileRows)
+	{
+		for (const auto &row : fileRows)
+		{
+			for (auto &obs : observables)
+			{
+				if (obs.colToRead < static_cast<int>(row.size()))
+					obs.push(row[obs.colToRead]);
+			}
+		}
+	}
+
+	std::vector<std::string> patterns;
+	std::vector<LiveObservable> observables;
+	WatchParams params;
+	// Rows of one data file, with their lines in the sorted raw file so that a rewrite formats nothing
+	struct FileRows
+	{
+		std::vector<std::vector<double>> values;
+		std::string text;
+	};
+
+	std::map<std::pair<int, std::string>, FileRows> rows; // Sorted by (configuration, file name)
+	std::map<std::uint64_t, std::string> contentOwner;    // Content hash -> first file with it
+	const std::regex landauRegex{"landau-(\\d+)\\.out"};
+	bool stale = false; // Rows were inserted out of order since the accumulators were last rebuilt
+	bool rewriteSorted = true; // The sorted raw file must be rewritten instead of appended to (always before the first write)
+	std::string appendedText;  // Lines of the rows appended since the last write
+};
+
+namespace watch_detail
+{
+	inline volatile std::sig_atomic_t stopRequested = 0;
+	inline void request_stop(int) { stopRequested = 1; }
+}
+
+/**
+ * @brief Long-running mode updating the sorted raw file and the autocorrelation outputs as new configurations land.
+ *
+ * @param[in] patterns The set of patterns to search for in the files.
+ * @param[in] columns Name and column of the sorted file of every observable.
+ * @param[in] dataPath The directory to be watched.
+ * @param[in] fileExtension The extension of the data files.
+ * @param[in] outputDirectory The directory of the outputs.
+ * @param[in] sortedFileName Name of the sorted raw file.
+ * @param[in] params Watch parameters.
+ *
+ * @details The files already present are ingested first (the watch is set up before
+ * the directory is listed, so no file is missed in between). Afterwards every batch of
+ * files closed at about the same time is parsed and the outputs are rewritten once;
+ * the time from the batch arriving to the rewritten outputs is printed for each
+ * update. Runs until SIGINT/SIGTERM or until params.idleSeconds pass without new files.
+ */
+void watch_operator(const std::vector<std::string> &patterns,
+										const std::vector<std::pair<std::string, int>> &columns,
+										const std::string &dataPath,
+										const std::string &fileExtension,
+										const std::string &outputDirectory,
+										const std::string &sortedFileName,
+										const WatchParams &params)
+{
+	DirectoryWatcher watcher(dataPath, fileExtension);
+	if (!watcher.ok())
+		return;
+
+	LiveAnalysis live(patterns, columns, params);
+	auto ingest = [&](const std::vector<fs::path> &files, const std::string &what)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		size_t added = 0;
+		for (const auto &file : files)
+		{
+			added += live.add_file(file);
+		}
+		if (added == 0)
+			return;
+		live.write_outputs(outputDirectory, sortedFileName);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "# watch: " << what << " +" << added << " file(s), " << live.num_files() << " in total, outputs updated in " << ms << " ms" << std::endl;
+	};
+
+	ingest(list_data_files({dataPath}, fileExtension, false), "initial scan");
+
+	watch_detail::stopRequested = 0;
+	auto previousInt = std::signal(SIGINT, watch_detail::request_stop);
+	auto previousTerm = std::signal(SIGTERM, watch_detail::request_stop);
+
+	std::cout << "# watch: watching " << dataPath << " for new *" << fileExtension << " files (Ctrl-C to stop)" << std::endl;
+	auto lastActivity = std::chrono::steady_clock::now();
+	while (!watch_detail::stopRequested)
+	{
+		std::vector<fs::path> files = watcher.wait(200);
+		if (watcher.overflowed())
+		{
+			// Events were lost: re-ingest the directory, known files are only replaced
+			files = list_data_files({dataPath}, fileExtension, false);
+		}
+		if (!files.empty())
+		{
+			ingest(files, "update");
+			lastActivity = std::chrono::steady_clock::now();
+		}
+		else if (params.idleSeconds > 0 &&
+						 std::chrono::steady_clock::now() - lastActivity > std::chrono::seconds(params.idleSeconds))
+		{
+			std::cout << "# watch: no new files for " << params.idleSeconds << " s, stopping" << std::endl;
+			break;
+		}
+	}
+
+	std::signal(SIGINT, previousInt);
+	std::signal(SIGTERM, previousTerm);
+}
+
+#endif // watch.hpp
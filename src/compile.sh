@@ -1,3 +1,3 @@
 #!/bin/bash
 
-g++ -o main main.cpp;
+g++ -std=c++20 -pthread -o main main.cpp;
@@ -1,8 +1,17 @@
 
 #include <iostream>
+#include <optional>
+#include <stdexcept>
 #include "../datalib/filehandler.hpp"
 #include "../datalib/stattools.hpp"
 #include "../datalib/spaceoperator.hpp"
+#include "../datalib/momentum.hpp"
+#include "../datalib/resultcache.hpp"
+#include "../datalib/rollingstats.hpp"
+#include "../datalib/fitting.hpp"
+#include "../datalib/taskgraph.hpp"
+#include "../datalib/replica.hpp"
+#include "../datalib/watch.hpp"
 
 #include "params.hpp"
 
@@ -15,113 +24,441 @@ int main()
       // Add other patterns as needed
   };
 
+  // Every pattern is one observable, e.g. GP_T_0000. The sorted file holds the configuration in column 0,
+  // then one column per pattern in the order above: this is the only place the columns are assigned.
+  std::vector<std::string> observableLabels;
+  std::vector<std::pair<std::string, int>> observableColumns; // Name and column of each observable
+  for (size_t p = 0; p < patterns.size(); ++p)
+  {
+    MomentumPattern mp;
+    const std::string label = patterns[p].substr(0, patterns[p].find(' '));
+    observableLabels.push_back(label);
+    observableColumns.emplace_back(parse_momentum_pattern(patterns[p], mp) ? label + "_" + momentum_to_string(mp.fixed) : label,
+                                   static_cast<int>(p) + 1);
+  }
+
   // Directory and extension path to data files
   const std::string dataPath = sysParams.dataPath;
+  std::vector<std::string> dataPaths = {dataPath};
+  dataPaths.insert(dataPaths.end(), sysParams.extraDataPaths.begin(), sysParams.extraDataPaths.end());
   const std::string fileExtension = sysParams.fileExtension;
   const std::string outputDirectory = sysParams.outputDirectory;
   
   std::cout << "\n*********************************************************\n\n"
             << "WARNING: Data will be read from: " << dataPath << "\n" 
+            << (sysParams.extraDataPaths.empty() ? "" : "         and from " + std::to_string(sysParams.extraDataPaths.size()) + " more directories\n")
             << "\n*********************************************************\n\n";
 
+  // Live monitoring of a running simulation: outputs are rewritten as configurations land
+  if (sysParams.watchMode)
+  {
+    const WatchParams watchParams = {sysParams.bin_size, sysParams.watchTauMax, sysParams.deduplicateFiles,
+                                     sysParams.outputFormat, sysParams.watchIdleSeconds};
+    watch_operator(patterns, observableColumns, dataPath, fileExtension, outputDirectory,
+                   "sorted_raw_GP0000.dat", watchParams);
+    return 0;
+  }
+
+  // Stage results are cached under the hash of their inputs and parameters
+  const std::string cacheDirectory = sysParams.cacheDirectory.empty() ? outputDirectory + "cache/" : sysParams.cacheDirectory;
+  ResultCache cache(sysParams.useResultCache ? cacheDirectory : "");
+  const std::string sortedFileData = outputDirectory + "sorted_raw_GP0000.dat";
+  StageKey ingestKey = file_key(sortedFileData);
+
 
+  // Stages of the analysis: each one runs as soon as the data it needs has been produced
+  TaskGraph graph;
+
+  // Distribution of each observable (quantiles and histogram), sketched from the values parsed by the ingest
+  bool sketchDistributions = false;
+  const SketchParams sketchParams = {sysParams.histogramRange[0], sysParams.histogramRange[1], sysParams.histogramBins};
+  std::vector<ObservableSketch> sketches; // Left empty when the ingest did not parse the files (cached or existing file)
 
   bool generateFile = true;
   if (generateFile)
   {
-    // Generate file
     const std::string outputFileName = "sorted_raw_GP0000.dat";
-    specialGen_sort_trunc_file_operator(patterns, outputFileName, dataPath, fileExtension, outputDirectory);
+    ingestKey = StageKey().add(directory_key(dataPath, fileExtension)).add(patterns).add(fileExtension).add(sysParams.deduplicateFiles);
+    for (const auto &path : sysParams.extraDataPaths)
+    {
+      ingestKey.add(directory_key(path, fileExtension));
+    }
+    graph.add_stage("ingest", {}, {"sorted_raw"}, [&, outputFileName]
+                    {
+      // Generate file
+      const ReadAheadParams ioParams = {sysParams.ioThreads, sysParams.ioFilesInFlight, sysParams.ioBytesInFlight};
+      const std::string labelIndexFile = sysParams.useLabelIndex ? (fs::path(dataPath) / ".label_index").string() : "";
+
+      // One set of sketches per reader thread, filled as the files are parsed and merged once they all are
+      std::vector<std::vector<ObservableSketch>> readerSketches;
+      std::function<void(const MatchData &, int)> onFile;
+      if (sketchDistributions)
+      {
+        readerSketches.assign(std::max(ioParams.numThreads, 1), make_sketches(patterns.size(), sketchParams));
+        onFile = [&](const MatchData &fileData, int reader)
+        { sketch_match_data(fileData, patterns, readerSketches[reader]); };
+      }
+      cache.file_stage("ingest", ingestKey, outputDirectory + outputFileName, [&]
+                       {
+        specialGen_sort_trunc_file_operator(patterns, outputFileName, dataPaths, fileExtension, outputDirectory, ioParams, labelIndexFile,
+                                            sysParams.deduplicateFiles, onFile);
+        sketches = merge_sketches(std::move(readerSketches)); }); });
 
     #pragma comment ( DANGER!!!: OS might break due to large file size )
     // Grep files in directory 
     //grep_directory(dataPath, outputDirectory + "grepFilter_raw_GP_T_0000.dat", "GP_T", fileExtension);
     //grep_directory(dataPath, outputDirectory + "grepFilter_raw_GP_L_0000.dat", "GP_L", fileExtension);
   }
+  else
+  {
+    graph.add_stage("ingest (existing file)", {}, {"sorted_raw"}, [] {});
+  }
   //===============================================================================
 
 
-  // Collect column data from file
-  std::string sortedFileData = outputDirectory + "sorted_raw_GP0000.dat";
-  int colToRead = 1; // Specify the column index to read (0-based)
-  std::vector<double> GP_T_0000_dat = readColumn(sortedFileData, colToRead);
-  colToRead = 2;
-  std::vector<double> GP_L_0000_dat = readColumn(sortedFileData, colToRead);
-  
+  // Extract all momenta in one pass into config x momentum tensors
+  bool extractAllMomenta = false;
+  if (extractAllMomenta)
+  {
+    graph.add_stage("momentum tensors", {}, {"tensors"}, [&]
+                    {
+      const std::vector<std::string> momentumPatterns = {"GP_T * * * *", "GP_L * * * *"};
+      // Equivalent momenta are averaged over their symmetry orbit as the files are parsed
+      const ReadAheadParams ioParams = {sysParams.ioThreads, sysParams.ioFilesInFlight, sysParams.ioBytesInFlight};
+      const OrbitParams orbitParams = {sysParams.momentumSymmetry, sysParams.timeDirection, sysParams.cylinderRadius, sysParams.coneAngle};
+      if (!check_orbit_params(orbitParams, sysParams.latticeExtent))
+        throw std::invalid_argument("invalid momentum orbit parameters");
+      std::vector<MomentumTensor> tensors = extract_momentum_tensors(dataPaths, fileExtension, momentumPatterns, ioParams,
+                                                                     sysParams.deduplicateFiles, orbitParams);
 
-  // Calculate mean value
-  double mean_value_GP_T = mean(GP_T_0000_dat);
-  double mean_value_GP_L = mean(GP_L_0000_dat);
+      std::vector<std::string> orbitInfo = {"# momentum orbits: " + symmetry_name(orbitParams.symmetry) +
+                                            ", cylinder cut: " + std::to_string(orbitParams.cylinderRadius) +
+                                            ", cone cut: " + std::to_string(orbitParams.coneAngle)};
+      for (size_t t = 0; t < tensors.size(); ++t)
+      {
+        std::string sizes = "# momenta per column:";
+        for (int m : tensors[t].multiplicity)
+        {
+          sizes += " " + std::to_string(m);
+        }
+        std::vector<std::string> extraInfo = orbitInfo;
+        extraInfo.push_back(sizes);
+        const std::string label = tensors[t].pattern.substr(0, tensors[t].pattern.find(' ')); // e.g. GP_T
+        write_momentum_tensor(tensors[t], outputDirectory + "tensor_" + label, sysParams.outputFormat, extraInfo);
+      }
 
-  // Calculate variance
-  double variance_value_GP_T = variance(GP_T_0000_dat);
-  double variance_value_GP_L = variance(GP_L_0000_dat);
+      // Fit the propagator as a function of p^2, with jackknife errors on the parameters
+      bool fitPropagator = false;
+      if (fitPropagator)
+      {
+        const std::vector<std::string> paramNames = {"Z", "M1^2", "M2^2", "M3^4"};
+        for (size_t t = 0; t < tensors.size(); ++t)
+        {
+          std::vector<double> p2;
+          std::vector<std::vector<double>> binned;
+          for (size_t m = 0; m < tensors[t].num_momenta(); ++m)
+          {
+            p2.push_back(lattice_momentum_squared(tensors[t].momenta[m], sysParams.latticeExtent));
+            binned.push_back(bin_data(tensors[t].series_view(m), sysParams.bin_size));
+          }
+          JackknifeFit<4> fit = jackknife_fit<4>(PropagatorModel(), p2, binned, {1.0, 1.0, 1.0, 1.0}, sysParams.fitThreads);
+          const std::string label = tensors[t].pattern.substr(0, tensors[t].pattern.find(' '));
+          write_fit_to_file(fit, PropagatorModel(), paramNames, outputDirectory + "fit_" + label + ".dat",
+                            {"# " + tensors[t].pattern});
+        }
+      } });
+  }
+  //===============================================================================
 
-  double jackErr_GP_T = jack_error(GP_T_0000_dat);
-  double jackErr_GP_L = jack_error(GP_L_0000_dat);
 
-  std::string str_mean_GP_T = "# mean: GP_T_0000: "  + std::to_string(mean_value_GP_T);
-  std::string str_mean_GP_L = "# mean: GP_L_0000: "  + std::to_string(mean_value_GP_L);
- 
-  std::string str_var_GP_T = "# variance: GP_T_0000: " + std::to_string(variance_value_GP_T);
-  std::string str_var_GP_L = "# variance: GP_L_0000: " + std::to_string(variance_value_GP_L);
- 
-  std::string str_jackErr_GP_T_str = "# jacknife error: GP_T_0000: " + std::to_string(jackErr_GP_T);
-  std::string str_jackErr_GP_L_str = "# jacknife error: GP_L_0000: " + std::to_string(jackErr_GP_L);
+  // Histograms and quantiles of each observable, written once the ingest is done
+  if (sketchDistributions)
+  {
+    graph.add_stage("sketches", {"sorted_raw"}, {"histograms"}, [&]
+                    {
+      std::vector<int> columns;
+      for (const auto &[_, column] : observableColumns)
+      {
+        columns.push_back(column);
+      }
+      if (sketches.empty())
+      {
+        // The files were not parsed in this run: sketch the columns of the sorted file instead
+        sketches = sketch_columns(sortedFileData, columns, sketchParams);
+      }
+      else
+      {
+        // Without a histogram range the ingest only filled the digests: their exact range bins one pass over the sorted file
+        fill_histograms_from_columns(sketches, sortedFileData, columns, sketchParams.numBins);
+      }
 
+      const std::vector<double> configColumn = readColumn(sortedFileData, 0);
+      const std::vector<int> configs(configColumn.begin(), configColumn.end());
+      const double qLow = sysParams.outlierQuantiles[0], qHigh = sysParams.outlierQuantiles[1];
+      for (size_t p = 0; p < patterns.size(); ++p)
+      {
+        const std::string &label = observableLabels[p];
+        std::vector<std::string> quantileInfo = {"# " + patterns[p]};
+        for (double q : {0.001, 0.01, 0.16, 0.5, 0.84, 0.99, 0.999})
+        {
+          quantileInfo.push_back("# quantile " + std::to_string(q) + ": " + std::to_string(sketches[p].digest.quantile(q)));
+        }
+        write_histogram_to_file(sketches[p].histogram, outputDirectory + "hist_" + label + ".dat", quantileInfo);
+
+        // Configurations whose value lies beyond the outlier quantiles
+        const std::vector<double> values = readColumn(sortedFileData, columns[p]);
+        if (values.size() != configs.size())
+        {
+          std::cerr << "Warning: " << label << " is missing in some rows of " << sortedFileData << ", its outliers are not flagged" << std::endl;
+          continue;
+        }
+        const std::vector<std::pair<int, double>> outliers = flag_outliers(sketches[p].digest, configs, values, qLow, qHigh);
+        write_pair_data_to_file(outliers, outputDirectory + "outliers_" + label + ".dat", {"#config", "value"},
+                                {"# " + patterns[p],
+                                 "# outside the quantiles " + std::to_string(qLow) + " (" + std::to_string(sketches[p].digest.quantile(qLow)) + ") and " +
+                                     std::to_string(qHigh) + " (" + std::to_string(sketches[p].digest.quantile(qHigh)) + ")",
+                                 "# flagged configurations: " + std::to_string(outliers.size())});
+      } });
+  }
+  //===============================================================================
 
-  //============================ Autocorrelation =================================
 
-  // Bin the data (bin_size = 1 for no binning effect)
+  // Results of one observable, each filled by its own stages
+  struct Observable
+  {
+    std::string label;  // e.g. GP_T
+    std::string name;   // e.g. GP_T_0000
+    int colToRead = 0;  // Column index of the observable in the sorted file (0-based)
+    StageKey key{};
+    std::vector<storage_t> data{}, binned{};
+    std::optional<SeriesSummary<storage_t>> summary{};
+    double mean = 0.0, variance = 0.0, jackErr = 0.0;
+    std::vector<std::pair<int, double>> corrCoefPair{};
+    std::vector<double> corrErrors{};  // Madras-Sokal error of each coefficient
+    double tauInt = 0.0;
+    std::size_t window = 0;
+    bool windowClosed = true;  // False if the coefficients end before the automatic window closes (tauInt is a lower bound)
+    BinaryLayout layout{};
+  };
+  std::vector<Observable> observables;
+  for (size_t p = 0; p < patterns.size(); ++p)
+  {
+    observables.push_back({observableLabels[p], observableColumns[p].first, observableColumns[p].second});
+  }
+
   int bin_size = sysParams.bin_size;
-  std::vector<double> GP_T_0000_dat_bin = bin_data(GP_T_0000_dat, bin_size);
-  std::vector<double> GP_L_0000_dat_bin = bin_data(GP_L_0000_dat, bin_size);
+  // The autocorrelation covers every lag of the binned series; the accuracy reports check the same lags
+  auto analysis_tau_max = [&](size_t numValues) { return static_cast<int>((numValues + bin_size - 1) / std::max(bin_size, 1)); };
+  const ReduceParams reduceParams{sysParams.statThreads, sysParams.reproducibleReductions ? Reduction::Reproducible : Reduction::Fast};
+  // Statistics depend on how the sums are reduced: the block size in Reproducible mode, the thread count in Fast mode
+  const StageKey reduceKey = StageKey().add(static_cast<int>(reduceParams.mode))
+                                 .add(reduceParams.mode == Reduction::Fast ? static_cast<std::size_t>(reduceParams.numThreads) : reduceParams.blockSize);
+  std::vector<std::string> writtenFiles;
+  for (Observable &obs : observables)
+  {
+    const std::string column = "column:" + obs.name, stats = "statistics:" + obs.name, corr = "autocorr:" + obs.name;
 
-  int tau_max = GP_T_0000_dat_bin.size();
-  std::vector<std::pair<int, double>> corrCoefPair_GP_T_0000;
-  std::vector<std::pair<int, double>> corrCoefPair_GP_L_0000;
+    // Collect column data from file
+    graph.add_stage("column " + obs.name, {"sorted_raw"}, {column}, [&, &obs = obs]
+                    {
+      obs.key = StageKey().add(ingestKey).add(obs.colToRead).add(sizeof(storage_t));
+      obs.data = cache.vector_stage<storage_t>("column", obs.key, [&]
+                                               { return readColumn<storage_t>(sortedFileData, obs.colToRead); }); });
 
-  // Calculate autocorrelation coefficients for each tau
-  autoCorrel_sample_operator(GP_T_0000_dat_bin, corrCoefPair_GP_T_0000, tau_max);
-  autoCorrel_sample_operator(GP_L_0000_dat_bin, corrCoefPair_GP_L_0000, tau_max);
-  
-  std::vector<double> dataCorrCoef_GP_T_0000;
-  std::vector<double> dataCorrCoef_GP_L_0000;
+    // Quantify the accuracy loss of single-precision storage
+    if (sysParams.checkPrecisionLoss)
+    {
+      graph.add_stage("precision loss " + obs.name, {"sorted_raw"}, {}, [&, &obs = obs]
+                      {
+        std::vector<double> values = readColumn(sortedFileData, obs.colToRead);
+        print_precision_loss(values, bin_size, analysis_tau_max(values.size()), obs.name); });
+    }
+
+    // Quantify the cost of thread-count independent reductions
+    if (sysParams.checkReductionOverhead)
+    {
+      graph.add_stage("reduction overhead " + obs.name, {"sorted_raw"}, {}, [&, &obs = obs]
+                      {
+        std::vector<double> values = readColumn(sortedFileData, obs.colToRead);
+        print_reduction_overhead(values, bin_size, analysis_tau_max(values.size()), obs.name); });
+    }
+
+    // Rolling statistics over Monte Carlo time (thermalization and drift monitoring)
+    bool monitorThermalization = false;
+    if (monitorThermalization)
+    {
+      graph.add_stage("rolling " + obs.name, {column}, {"rolling_" + obs.name + ".dat"}, [&, &obs = obs]
+                      {
+        const std::vector<int> windows = {100, 1000, 10000};
+        rolling_stats_operator(obs.data, windows, sysParams.bin_size, outputDirectory + "rolling_" + obs.name + ".dat"); });
+    }
+
+    // One fused pass per observable serves every statistic missing from the cache
+    graph.add_stage("statistics " + obs.name, {column}, {stats}, [&, &obs = obs]
+                    {
+      auto summary_of = [&]() -> const SeriesSummary<storage_t> &
+      {
+        if (!obs.summary)
+          obs.summary = summarize_series(obs.data, bin_size, reduceParams);
+        return *obs.summary;
+      };
+
+      // Calculate mean value, variance and jackknife error
+      const StageKey statKey = StageKey(obs.key).add(reduceKey);
+      obs.mean = cache.scalar_stage("mean", statKey, [&] { return summary_of().mean; });
+      obs.variance = cache.scalar_stage("variance", statKey, [&] { return summary_of().variance; });
+      obs.jackErr = cache.scalar_stage("jack_error", statKey, [&] { return summary_of().jackErr; });
+
+      // Bin the data (bin_size = 1 for no binning effect)
+      obs.binned = cache.vector_stage<storage_t>("bin_data", StageKey(statKey).add(bin_size), [&]
+                                                 { return summary_of().binned; }); });
+
+    //============================ Autocorrelation =================================
+
+    // Calculate autocorrelation coefficients for each tau (cached as the coefficient column)
+    graph.add_stage("autocorr " + obs.name, {stats}, {corr}, [&, &obs = obs]
+                    {
+      int tau_max = analysis_tau_max(obs.data.size());
+      std::vector<double> coefs = cache.vector_stage<double>("autocorr", StageKey(obs.key).add(reduceKey).add(bin_size).add(tau_max), [&]
+                                                             {
+        if (!obs.summary)
+          obs.summary = summarize_series(obs.data, bin_size, reduceParams);
+        std::vector<double> column(std::min<size_t>(tau_max, obs.summary->binned.size()));
+        autoCorrel_coefficients(obs.summary->binned, std::span<double>(column), obs.summary->binnedMean, obs.summary->c_0, reduceParams);
+        return column; });
+      for (size_t tau = 0; tau < coefs.size(); ++tau)
+      {
+        obs.corrCoefPair.push_back(std::make_pair(static_cast<int>(tau), coefs[tau]));
+      }
+      obs.window = autoCorrel_error_operator(obs.corrCoefPair, obs.binned.size(), obs.corrErrors, &obs.tauInt, &obs.windowClosed);
+      if (!obs.windowClosed)
+      {
+        std::cerr << "Warning: the autocorrelation window of " << obs.name << " did not close within " << obs.corrCoefPair.size()
+                  << " lags, tau_int is a lower bound" << std::endl;
+      } });
 
-  // Extract autocorrelation coefficients 
-  for (auto pair : corrCoefPair_GP_T_0000)
+    // Write autocorrelation results to file.
+    const std::string outputFile = "autocorr_" + obs.name + output_extension(sysParams.outputFormat);
+    writtenFiles.push_back(outputFile);
+    graph.add_stage("write " + obs.name, {stats, corr}, {outputFile}, [&, &obs = obs]
+                    {
+      std::vector<std::string> extraInfo = {"# mean: " + obs.name + ": " + std::to_string(obs.mean),
+                                            "# variance: " + obs.name + ": " + std::to_string(obs.variance),
+                                            "# jacknife error: " + obs.name + ": " + std::to_string(obs.jackErr),
+                                            "# tau_int: " + obs.name + ": " + std::to_string(obs.tauInt) + " (window " + std::to_string(obs.window) +
+                                                (obs.windowClosed ? ")" : ", not closed: lower bound)")};
+      write_pair_data(obs.corrCoefPair,
+                      outputDirectory + "autocorr_" + obs.name,
+                      {"#tau", "corr_coef", "corr_err"},
+                      extraInfo, sysParams.outputFormat, &obs.layout, obs.corrErrors); });
+  }
+
+  // Independent Markov chains (replicas): dataPath is the first one, replicaPaths hold the others
+  const bool useReplicas = !sysParams.replicaPaths.empty() || sysParams.replicaFirstConfigs.size() > 1;
+  if (useReplicas)
   {
-    dataCorrCoef_GP_T_0000.push_back(pair.second);
+    std::vector<std::string> replicaFiles = {sortedFileData}, replicaNames = {dataPath}, replicaInputs = {"sorted_raw"};
+    for (size_t k = 0; k < sysParams.replicaPaths.size(); ++k)
+    {
+      const std::string replicaPath = sysParams.replicaPaths[k];
+      const std::string replicaFileName = "sorted_raw_GP0000_replica" + std::to_string(k + 1) + ".dat";
+      replicaFiles.push_back(outputDirectory + replicaFileName);
+      replicaNames.push_back(replicaPath);
+      replicaInputs.push_back("sorted_raw_replica" + std::to_string(k + 1));
+      graph.add_stage("ingest replica " + std::to_string(k + 1), {}, {replicaInputs.back()}, [&, replicaPath, replicaFileName]
+                      {
+        const ReadAheadParams ioParams = {sysParams.ioThreads, sysParams.ioFilesInFlight, sysParams.ioBytesInFlight};
+        const std::string labelIndexFile = sysParams.useLabelIndex ? (fs::path(replicaPath) / ".label_index").string() : "";
+        const StageKey replicaKey = StageKey().add(directory_key(replicaPath, fileExtension)).add(patterns).add(fileExtension).add(sysParams.deduplicateFiles);
+        cache.file_stage("ingest", replicaKey, outputDirectory + replicaFileName, [&]
+                         { specialGen_sort_trunc_file_operator(patterns, replicaFileName, {replicaPath}, fileExtension, outputDirectory, ioParams, labelIndexFile, sysParams.deduplicateFiles); }); });
+    }
+
+    for (Observable &obs : observables)
+    {
+      graph.add_stage("replicas " + obs.name, replicaInputs, {"autocorr_" + obs.name + "_replicas"}, [&, &obs = obs, replicaFiles, replicaNames]
+                      {
+        ReplicaSeries<storage_t> replicas;
+        for (size_t k = 0; k < replicaFiles.size(); ++k)
+        {
+          std::vector<double> configColumn = readColumn(replicaFiles[k], 0);
+          std::vector<int> configs(configColumn.begin(), configColumn.end());
+          std::vector<storage_t> values = readColumn<storage_t>(replicaFiles[k], obs.colToRead);
+          // dataPath may hold several chains back to back; every other directory is one chain with its own first configuration
+          std::vector<int> firstConfigs = sysParams.replicaFirstConfigs;
+          if (k > 0)
+          {
+            firstConfigs.clear();
+            if (k - 1 < sysParams.replicaPathFirstConfigs.size())
+              firstConfigs.push_back(sysParams.replicaPathFirstConfigs[k - 1]);
+          }
+          split_replicas<storage_t>(replicaNames[k], configs, values, firstConfigs, replicas);
+        }
+
+        // Each replica is summarized and correlated on its own thread, then combined
+        ReplicaSummary<storage_t> summary = summarize_replicas(replicas, bin_size, sysParams.pipelineThreads);
+        int tau_max = 0;
+        for (size_t r = 0; r < summary.binned.num_replicas(); ++r)
+        {
+          tau_max = std::max(tau_max, static_cast<int>(summary.binned.replica(r).size()));
+        }
+        std::vector<std::pair<int, double>> corrCoefPair;
+        replica_autoCorrel_sample_operator(summary.binned, corrCoefPair, tau_max, summary.combined.binnedMean, summary.combined.c_0,
+                                           sysParams.pipelineThreads);
+        std::vector<double> corrErrors;
+        double tauInt = 0.0;
+        bool windowClosed = true;
+        std::size_t window = autoCorrel_error_operator(corrCoefPair, summary.binned.size(), corrErrors, &tauInt, &windowClosed);
+
+        std::vector<std::string> extraInfo = {"# mean: " + obs.name + ": " + std::to_string(summary.combined.mean),
+                                              "# variance: " + obs.name + ": " + std::to_string(summary.combined.variance),
+                                              "# jacknife error: " + obs.name + ": " + std::to_string(summary.combined.jackErr) + " (bins inside each replica)",
+                                              "# replica jacknife error: " + obs.name + ": " + std::to_string(summary.replicaJackErr) + " (leaving out one replica at a time)",
+                                              "# tau_int: " + obs.name + ": " + std::to_string(tauInt) + " (window " + std::to_string(window) +
+                                                  (windowClosed ? ")" : ", not closed: lower bound)"),
+                                              "# replicas: " + std::to_string(replicas.num_replicas())};
+        for (size_t r = 0; r < replicas.num_replicas(); ++r)
+        {
+          extraInfo.push_back("#   " + replicas.names[r] + ": " + std::to_string(summary.replicas[r].size) + " configs, mean " +
+                              std::to_string(summary.replicas[r].mean) + " +- " + std::to_string(summary.replicas[r].jackErr));
+        }
+        write_pair_data(corrCoefPair,
+                        outputDirectory + "autocorr_" + obs.name + "_replicas",
+                        {"#tau", "corr_coef", "corr_err"},
+                        extraInfo, sysParams.outputFormat, nullptr, corrErrors); });
+    }
   }
-  for (auto pair : corrCoefPair_GP_L_0000)
+
+  // Binary results are plotted straight from the records
+  if (sysParams.outputFormat != OutputFormat::Text)
   {
-    dataCorrCoef_GP_L_0000.push_back(pair.second);
+    graph.add_stage("gnuplot script", writtenFiles, {"plot_autocorr_GP.gnu"}, [&]
+                    {
+      std::vector<GnuplotSeries> series;
+      for (auto it = observables.rbegin(); it != observables.rend(); ++it)
+      {
+        series.push_back({it->layout, it->label});
+      }
+      write_gnuplot_binary_script(outputDirectory + "plot_autocorr_GP.gnu", series,
+                                  "Config", "Auto-Correlation Coef. GP", "GP 0 0 0 0"); });
   }
-  
-  // Write autocorrelation results to file.
-  std::vector<std::string> extraInfo_GP_T_0000 = {str_mean_GP_T, str_var_GP_T, str_jackErr_GP_T_str};
-  std::vector<std::string> extraInfo_GP_L_0000 = {str_mean_GP_L, str_var_GP_L, str_jackErr_GP_L_str};
-
-  write_pair_data_to_file(corrCoefPair_GP_T_0000, 
-                          outputDirectory + "autocorr_GP_T_0000.dat",
-                          {"#tau", "corr_coef"},
-                          extraInfo_GP_T_0000);
- 
-  write_pair_data_to_file(corrCoefPair_GP_L_0000,
-                          outputDirectory + "autocorr_GP_L_0000.dat",
-                          {"#tau", "corr_coef"},
-                          extraInfo_GP_L_0000);
+
+  // A stage that failed, or was skipped because an input failed, makes the whole run fail
+  const bool pipelineOk = graph.run(sysParams.pipelineThreads);
 
   //===============================================================================
 
+  graph.print_report();
+  cache.print_report();
+
   // Output the values in the column
   if (false)
   {
-    std::cout << "Column " << colToRead << " data:\n";
-    for (const double &value : GP_T_0000_dat)
+    std::cout << "Column " << observables[0].colToRead << " data:\n";
+    for (const storage_t &value : observables[0].data)
     {
       std::cout << value << "\n";
     }
   }
-  return 0;
+  return pipelineOk ? 0 : 1;
 }
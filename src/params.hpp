@@ -1,15 +1,58 @@
 #ifndef PARAMS_HPP
 #define PARAMS_HPP
 
+#include <array>
+#include <string>
+#include <vector>
+
+#include "../datalib/binaryio.hpp" // OutputFormat
+#include "../datalib/momentum.hpp" // MomentumSymmetry
+
+// Storage type of the raw series: float halves the memory footprint and traffic, statistics still accumulate in double
+using storage_t = double;
+
 struct Params
 {
   int bin_size = 1; // Bin size for averaging when applied Binning to data
   int tau_max = 1;  // Maximum time displacement for autocorrelation
+  bool checkPrecisionLoss = false; // Report the accuracy loss of float storage before the analysis
+  std::array<double, 2> histogramRange = {0.0, 0.0};       // Lower and upper edge of the distribution histograms (equal edges: the range of the data)
+  int histogramBins = 100;                                 // Number of bins of the distribution histograms
+  std::array<double, 2> outlierQuantiles = {0.001, 0.999}; // Configurations beyond these quantiles are listed in outliers_<label>.dat
+  bool useResultCache = false;     // Reuse stage results whose inputs and parameters did not change (stored under cacheDirectory)
+
+  int pipelineThreads = 4;                    // Number of threads running independent analysis stages (0 for all hardware threads)
+  int ioThreads = 4;                          // Number of reader threads used during ingest
+  int ioFilesInFlight = 16;                   // Maximum number of files read ahead of the parser
+  std::size_t ioBytesInFlight = 256UL << 20;  // Maximum number of bytes read ahead of the parser
+
+  std::array<int, 4> latticeExtent = {48, 48, 48, 48}; // Lattice extent in each momentum direction, for p^2 in the propagator fits
+  int fitThreads = 0;                                  // Number of threads refitting jackknife samples (0 for all hardware threads)
+  MomentumSymmetry momentumSymmetry = MomentumSymmetry::None;        // Orbits of momenta averaged while extracting the momentum tensors (None keeps every momentum)
+  int timeDirection = 3;                                             // Momentum component along the time direction, 0..3 (Spatial symmetry)
+  double cylinderRadius = -1.0;                                      // Cylinder cut around the diagonal, in integer momentum units (negative: no cut)
+  double coneAngle = -1.0;                                           // Cone cut around the diagonal, in degrees (negative: no cut)
+
+  int statThreads = 1;               // Number of threads summing each statistic
+  bool reproducibleReductions = true; // Bit-identical statistics for any statThreads (fixed blocks and reduction tree)
+  bool checkReductionOverhead = false; // Report the cost of reproducible reductions before the analysis
+
+  bool watchMode = false;   // Watch dataPath and update the outputs live as new configurations land, instead of one batch analysis
+  int watchTauMax = 100;    // Lags of the live autocorrelation; every new configuration costs O(watchTauMax)
+  int watchIdleSeconds = 0; // Stop watching after this many seconds without new files (0 to run until Ctrl-C)
 
   //std::string dataPath = "/home/eduardo-salgado/gluon_prop/Navigator/to_send_48_3_10/copy_of_48_3_10"; // Path to directory containing data files
   std::string dataPath = "/home/eduardo-salgado/gluon_prop/Navigator/output_48_3_12/output_48_3_12";
+  std::vector<std::string> extraDataPaths = {}; // Further directories with configurations of the same chain as dataPath (e.g. restarts); duplicates across all of them are skipped
   std::string fileExtension = ".out"; // File extension of data files to be analyzed
   std::string outputDirectory = "/home/eduardo-salgado/Lattice_QFT/Data_Analysis/output/GP_0000_12/"; // Path to directory where output files will be saved
+  std::vector<std::string> replicaPaths = {}; // Directories of further independent Markov chains (replicas) of the ensemble in dataPath
+  std::vector<int> replicaFirstConfigs = {};   // First configuration number of each replica stored back to back in dataPath (dataPath only)
+  std::vector<int> replicaPathFirstConfigs = {}; // First configuration used from each of replicaPaths, e.g. its own thermalization cut (missing entries: all)
+  std::string cacheDirectory = ""; // Path to the result cache (defaults to outputDirectory + "cache/")
+  bool useLabelIndex = false; // Keep a byte-offset index of the label lines in dataPath + "/.label_index" (writes into the data directory)
+  bool deduplicateFiles = true; // Skip data files whose contents duplicate another file
+  OutputFormat outputFormat = OutputFormat::Text; // Text (.dat), raw binary records (.bin) or NumPy arrays (.npy); binary formats also get a gnuplot script
 };
 
 Params sysParams;